@@ -0,0 +1,248 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <spdlog/spdlog.h>
+#include <../src/handler/Handler.hpp>
+#include <../src/common/MemoryBus.hpp>
+
+using namespace WakeOnLanImpl;
+
+#define SIMULATOR_STEP_MS 20
+#define SIMULATOR_STEP_REAL_US 200
+#define SIMULATOR_STEP_REAL_US_PER_NODE 8
+#define SIMULATOR_MAX_SETTLE_ROUNDS 1000
+#define SIMULATOR_SCENARIO_LIMIT_MS 300000
+#define SIMULATOR_NOT_CONVERGED UINT64_MAX
+
+/**
+ * A simulated host: a full API stack (Network handler, services and table) attached to the in-memory bus.
+ */
+struct Node {
+    std::string ip;
+    std::unique_ptr<Table> table;
+    std::unique_ptr<Handler> handler;
+};
+
+/**
+ * The outcome of a scenario: the virtual time it took and the messages sent while it ran.
+ */
+struct Outcome {
+    uint64_t elapsed;
+    MemoryBus::Counters messages;
+};
+
+/**
+ * A group of simulated hosts sharing a virtual clock and an in-memory bus. Host 0 starts as the manager and the
+ * others as participants.
+ */
+class Cluster {
+public:
+    Cluster(size_t noNodes, double loss, uint32_t latency, uint32_t seed, ElectionMode mode)
+        : clock(std::make_shared<VirtualClock>()),
+          bus(clock, seed),
+          realStep(SIMULATOR_STEP_REAL_US + noNodes * SIMULATOR_STEP_REAL_US_PER_NODE)
+    {
+        bus.setLoss(loss);
+        bus.setLatency(latency, latency);
+        for (size_t i = 0; i < noNodes; i++) {
+            char mac[18];
+            snprintf(mac, sizeof(mac), "02:00:00:00:%02X:%02X", (unsigned)(i / 256) % 256, (unsigned)i % 256);
+            Node node;
+            node.ip = "10." + std::to_string((i + 1) / 65536) + "." + std::to_string(((i + 1) / 256) % 256)
+                      + "." + std::to_string((i + 1) % 256);
+            Config config("host-" + std::to_string(i), node.ip, mac);
+            config.setHandlerType(i == 0 ? HandlerType::Manager : HandlerType::Participant);
+            config.setElectionMode(mode);
+            node.table = std::make_unique<Table>();
+            node.handler = std::make_unique<Handler>(config, *node.table, clock, bus.attach(node.ip), false);
+            nodes.push_back(std::move(node));
+        }
+        alive.assign(noNodes, true);
+    }
+
+    ~Cluster() {
+        /* Silences every host first: stopping them one by one would start elections among the remaining ones */
+        for (size_t i = 0; i < nodes.size(); i++)
+            kill(i);
+
+        /* Keeps the time moving, so the services blocked on a deadline notice they were stopped */
+        std::atomic<bool> stopping(true);
+        std::thread ticker([this, &stopping]() {
+            while (stopping) {
+                clock->advance(SIMULATOR_STEP_MS);
+                std::this_thread::sleep_for(std::chrono::microseconds(SIMULATOR_STEP_REAL_US));
+            }
+        });
+        for (auto &node : nodes)
+            node.handler->stop();
+        nodes.clear();
+        stopping = false;
+        ticker.join();
+    }
+
+    void start() {
+        for (auto &node : nodes)
+            node.handler->run();
+    }
+
+    void kill(size_t i) {
+        bus.kill(nodes[i].ip);
+        alive[i] = false;
+    }
+
+    /**
+     * Advances the virtual time until the predicate holds, giving the services real time to react on every step.
+     */
+    Outcome runUntil(const std::function<bool()> &converged) {
+        bus.resetCounters();
+        uint64_t start = clock->now();
+        while (!converged()) {
+            if (clock->now() - start > SIMULATOR_SCENARIO_LIMIT_MS)
+                return Outcome{SIMULATOR_NOT_CONVERGED, bus.getTotals()};
+            clock->advance(SIMULATOR_STEP_MS);
+            settle();
+        }
+        return Outcome{clock->now() - start, bus.getTotals()};
+    }
+
+    /**
+     * Gives the services real time to handle a step: waits until no message is due and the hosts stopped sending,
+     * so a slow machine does not turn into lost messages and spurious timeouts.
+     */
+    void settle() {
+        for (int round = 0; round < SIMULATOR_MAX_SETTLE_ROUNDS; round++) {
+            uint64_t sent = bus.getTotals().sent;
+            std::this_thread::sleep_for(std::chrono::microseconds(realStep));
+            if (!bus.hasDueMessages() && bus.getTotals().sent == sent)
+                return;
+        }
+    }
+
+    /**
+     * Indicates the group converged: the manager has every live host on its table as awake,
+     * and every live host applied the last table update of the manager.
+     */
+    bool discovered() {
+        auto manager = nodes[0].table->snapshot();
+        if (manager.second.size() != nodes.size() - 1)
+            return false;
+        for (auto &member : manager.second)
+            if (member.status != Table::ParticipantStatus::Awaken)
+                return false;
+        for (size_t i = 1; i < nodes.size(); i++)
+            if (nodes[i].table->sequence() != manager.first)
+                return false;
+        return true;
+    }
+
+    /**
+     * Indicates the live hosts agree on a new manager: a single live host runs as manager and every other
+     * live host follows it.
+     */
+    bool failedOver() {
+        std::string managerIp;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (!alive[i] || nodes[i].handler->getHandlerType() != HandlerType::Manager)
+                continue;
+            if (!managerIp.empty())
+                return false;
+            managerIp = nodes[i].ip;
+        }
+        if (managerIp.empty())
+            return false;
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (alive[i] && nodes[i].ip != managerIp && nodes[i].handler->getManagerIp() != managerIp)
+                return false;
+        return true;
+    }
+
+    ElectionStats getElectionStats() {
+        ElectionStats total{0, 0, LatencyHistogram()};
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (!alive[i])
+                continue;
+            auto stats = nodes[i].handler->getElectionStats();
+            total.noElections += stats.noElections;
+            total.noTimeouts += stats.noTimeouts;
+        }
+        return total;
+    }
+private:
+    std::shared_ptr<VirtualClock> clock;
+    MemoryBus bus;
+    uint64_t realStep;
+    std::vector<Node> nodes;
+    std::vector<bool> alive;
+};
+
+/**
+ * Formats a scenario time, in milliseconds of virtual time.
+ */
+std::string formatTime(uint64_t elapsed) {
+    return elapsed == SIMULATOR_NOT_CONVERGED ? "timeout" : std::to_string(elapsed);
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    double loss = 0;
+    uint32_t latency = 0;
+    uint32_t seed = 1;
+    ElectionMode mode = ElectionMode::Bully;
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg == "--loss" && i + 1 < argc)
+            loss = std::stod(argv[++i]);
+        else if (arg == "--latency" && i + 1 < argc)
+            latency = std::stoul(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = std::stoul(argv[++i]);
+        else if (arg == "--fast-failover")
+            mode = ElectionMode::FastFailover;
+        else
+            sizes.push_back(std::stoul(arg));
+    }
+    if (sizes.empty())
+        sizes = {10, 50, 100, 250, 500};
+
+    std::system("mkdir -p logs");
+    auto log = spdlog::basic_logger_mt("wakeonlan-api", "logs/cluster-simulator.log");
+    log->set_level(spdlog::level::warn);
+
+    std::cout << "Cluster simulator: loss " << loss * 100 << "%, latency " << latency << " ms, seed " << seed
+              << (mode == ElectionMode::FastFailover ? ", fast failover" : "") << " (times in virtual ms)" << std::endl;
+    std::cout << std::left << std::setw(8) << "NODES"
+              << std::setw(14) << "DISCOVERY"
+              << std::setw(14) << "MSGS/NODE"
+              << std::setw(14) << "FAILOVER"
+              << std::setw(14) << "MSGS/NODE"
+              << "ELECTIONS (ALL HOSTS)" << std::endl;
+
+    for (size_t size : sizes) {
+        if (size < 2)
+            continue;
+        Cluster cluster(size, loss, latency, seed, mode);
+        cluster.start();
+        Outcome discovery = cluster.runUntil([&cluster]() { return cluster.discovered(); });
+
+        Outcome failover{SIMULATOR_NOT_CONVERGED, MemoryBus::Counters{0, 0, 0}};
+        if (discovery.elapsed != SIMULATOR_NOT_CONVERGED) {
+            cluster.kill(0);
+            failover = cluster.runUntil([&cluster]() { return cluster.failedOver(); });
+        }
+        auto elections = cluster.getElectionStats();
+
+        std::cout << std::left << std::setw(8) << size
+                  << std::setw(14) << formatTime(discovery.elapsed)
+                  << std::setw(14) << discovery.messages.sent / size
+                  << std::setw(14) << formatTime(failover.elapsed)
+                  << std::setw(14) << failover.messages.sent / size
+                  << elections.noElections << " ended, " << elections.noTimeouts << " timed-out" << std::endl;
+    }
+}
@@ -0,0 +1,179 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <random>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <deque>
+#include <unordered_map>
+#include <../src/common/Table.hpp>
+
+using namespace WakeOnLanImpl;
+
+#define BENCHMARK_GROUP_SIZE 10000
+#define BENCHMARK_DURATION_MS 2000
+
+/**
+ * Creates a participant of the benchmark group.
+ */
+Table::Participant makeParticipant(size_t i) {
+    Table::Participant participant;
+    participant.hostname = "host-" + std::to_string(i);
+    participant.ip = "10." + std::to_string(i / 65536) + "." + std::to_string((i / 256) % 256) + "." + std::to_string(i % 256);
+    participant.mac = "00:00:00:00:00:00";
+    participant.status = Table::ParticipantStatus::Awaken;
+    participant.electedTimestamp = "N/A";
+    return participant;
+}
+
+/**
+ * The table before sharding: a single mutex over the whole table, and every mutation returns a copy of it.
+ * Kept here as the baseline of the benchmark.
+ */
+class BaselineTable {
+public:
+    std::pair<uint32_t, std::vector<Table::Participant>> insert(const Table::Participant &participant) {
+        uint32_t updateSeqNo = 0;
+        std::lock_guard<std::mutex> lk(tableMutex);
+        if (data.insert(std::make_pair(participant.hostname, participant)).second) {
+            updateSeqNo = ++seq;
+            publish(participant);
+        }
+        return std::make_pair(updateSeqNo, members());
+    }
+
+    std::pair<uint32_t, std::vector<Table::Participant>> update(const Table::ParticipantStatus &status,
+                                                                const std::string &hostname) {
+        uint32_t updateSeqNo = 0;
+        std::lock_guard<std::mutex> lk(tableMutex);
+        auto it = data.find(hostname);
+        if (it != data.end() && it->second.status != status) {
+            it->second.status = status;
+            updateSeqNo = ++seq;
+            publish(it->second);
+        }
+        return std::make_pair(updateSeqNo, members());
+    }
+
+    std::pair<uint32_t, std::vector<Table::Participant>> remove(const std::string &hostname) {
+        uint32_t updateSeqNo = 0;
+        std::lock_guard<std::mutex> lk(tableMutex);
+        if (data.erase(hostname)) {
+            updateSeqNo = ++seq;
+            Table::Participant removed;
+            removed.hostname = hostname;
+            publish(removed);
+        }
+        return std::make_pair(updateSeqNo, members());
+    }
+
+    Table::Participant get_manager() {
+        std::lock_guard<std::mutex> lk(tableMutex);
+        for (auto &entry : data)
+            if (entry.second.status == Table::ParticipantStatus::Manager)
+                return entry.second;
+        return Table::Participant();
+    }
+
+private:
+    std::vector<Table::Participant> members() {
+        std::vector<Table::Participant> members;
+        members.reserve(data.size());
+        for (auto &entry : data)
+            members.push_back(entry.second);
+        return members;
+    }
+
+    void publish(const Table::Participant &participant) {
+        feed.push_back(participant);
+        while (feed.size() > 4096)
+            feed.pop_front();
+    }
+
+    std::mutex tableMutex;
+    std::unordered_map<std::string, Table::Participant> data;
+    std::deque<Table::Participant> feed;
+    uint32_t seq = 0;
+};
+
+/**
+ * Runs a mixed workload over a table for a fixed time, returning the operations per second.
+ * Every operation but the manager lookups writes the table:
+ * - 60% status flips (hosts falling asleep or waking up);
+ * - 20% lookups of the manager (election and interface reads);
+ * - 20% inserts or removes (discovery joins and exits).
+ */
+template <typename T>
+double run(T &table, size_t noThreads) {
+    std::atomic<bool> active(true);
+    std::atomic<uint64_t> noOps(0);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < noThreads; t++) {
+        threads.emplace_back([&table, &active, &noOps, t]() {
+            std::mt19937 rng(t + 1);
+            std::uniform_int_distribution<size_t> host(0, BENCHMARK_GROUP_SIZE - 1);
+            std::uniform_int_distribution<int> op(0, 99);
+            uint64_t ops = 0;
+            while (active) {
+                size_t i = host(rng);
+                int o = op(rng);
+                if (o < 60) {
+                    table.update(o % 2 ? Table::ParticipantStatus::Sleeping : Table::ParticipantStatus::Awaken,
+                                 "host-" + std::to_string(i));
+                }
+                else if (o < 80) {
+                    table.get_manager();
+                }
+                else if (o % 2) {
+                    table.insert(makeParticipant(BENCHMARK_GROUP_SIZE + i));
+                }
+                else {
+                    table.remove("host-" + std::to_string(BENCHMARK_GROUP_SIZE + i));
+                }
+                ops++;
+            }
+            noOps += ops;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(BENCHMARK_DURATION_MS));
+    active = false;
+    for (auto &thread : threads)
+        thread.join();
+    return noOps * 1000.0 / BENCHMARK_DURATION_MS;
+}
+
+int main(int argc, char** argv) {
+    size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1)
+        maxThreads = std::stoul(argv[1]);
+    std::cout << "Table benchmark: " << BENCHMARK_GROUP_SIZE << " participants, "
+              << BENCHMARK_DURATION_MS << " ms per run" << std::endl;
+    std::cout << std::left << std::setw(10) << "THREADS"
+              << std::setw(20) << "BASELINE (ops/s)"
+              << std::setw(20) << std::to_string(WAKEONLAN_TABLE_SHARDS) + " SHARDS (ops/s)"
+              << "SPEEDUP" << std::endl;
+
+    for (size_t noThreads = 1; noThreads <= maxThreads; noThreads *= 2) {
+        double throughput[2];
+        {
+            BaselineTable table;
+            for (size_t h = 0; h < BENCHMARK_GROUP_SIZE; h++)
+                table.insert(makeParticipant(h));
+            throughput[0] = run(table, noThreads);
+        }
+        {
+            Table table;
+            for (size_t h = 0; h < BENCHMARK_GROUP_SIZE; h++)
+                table.insert(makeParticipant(h));
+            throughput[1] = run(table, noThreads);
+        }
+        std::cout << std::left << std::setw(10) << noThreads
+                  << std::setw(20) << std::fixed << std::setprecision(0) << throughput[0]
+                  << std::setw(20) << throughput[1]
+                  << std::setprecision(2) << throughput[1] / throughput[0] << "x" << std::endl;
+    }
+}
@@ -1,15 +1,17 @@
 #include <memory>
+#include <string>
 #include <unistd.h>
 #include <csignal>
 #include <ApiInstance.hpp>
 
-bool quit = false;
+volatile std::sig_atomic_t quit = 0;
 
 void signalHandler(int signum) {
-    quit = true;
+    quit = 1;
 }
 
 void terminate() {
+    signal(SIGTERM, SIG_DFL);
     pid_t pid = getpid();
     std::string killCmd("kill ");
     killCmd.append(std::to_string(pid));
@@ -18,10 +20,13 @@ void terminate() {
 
 int main(int argc, char** argv) {
     signal(SIGINT, signalHandler);
+    signal(SIGTERM, signalHandler);
     /*************************************
     * Setting up the API configuration
     *************************************/
     WakeOnLan::Config config;
+    if (argc > 1 && std::string(argv[1]) == "--headless")
+        config.setHeadless(true);
 
     /*************************************
     * API instantiation
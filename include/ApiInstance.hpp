@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include <Config.hpp>
+#include <Types.hpp>
 
 namespace WakeOnLanImpl {
     class ApiInstanceImpl;
@@ -30,7 +31,7 @@ namespace WakeOnLan {
         /**
          * Runs the services provided by the API. When called, all the main services (discovery, monitoring,
          * and interface) start running. On this point, host is already listening  or transmitting packets on
-         * the Wake-on-LAN API preconfigured port (4000) for starting the manager-participants communication.
+         * the configured service port (4000 by default) for starting the manager-participants communication.
          *
          * @returns None.
         */
@@ -44,6 +45,38 @@ namespace WakeOnLan {
          * @returns None.
         */
         void stop();
+
+        /**
+         * Waits for changes on the group table after a given version. Any number of threads can wait
+         * concurrently, each one keeping its own version. A new caller passes version 0 and receives the
+         * whole group as Inserted changes; the following calls return only the members changed since the
+         * version passed. The function returns the same version and no changes when the timeout expires.
+         *
+         * @param version The table version returned by the previous call (0 on the first call).
+         * @param timeoutMs The maximum time to wait for changes, in milliseconds.
+         * @returns The changes applied to the group table after the version.
+        */
+        TableChanges waitForTableChanges(uint64_t version, uint32_t timeoutMs);
+
+        /**
+         * Gets the elections observed by the local host since the API started: how many ended with a coordinator,
+         * how many timed-out, and the histogram of the time from the election start to the coordinator
+         * announcement (the failover latency seen by the host).
+         *
+         * @returns The election statistics.
+        */
+        ElectionStats getElectionStats();
+
+        /**
+         * Tells the manager the local host is about to suspend. Called just before the host goes to sleep, it lets
+         * the manager mark the host as Sleeping at once, instead of after a missed monitoring request, and stop
+         * probing it. The host announces itself again when it resumes, or after 10 seconds when it did not suspend.
+         * The announcement is a single datagram: when it is lost, the manager still finds out through the monitoring
+         * requests.
+         *
+         * @returns A bool indicating the announcement was sent (false when the host is the manager or follows none).
+        */
+        bool announceSleep();
     private:
         std::unique_ptr<WakeOnLanImpl::ApiInstanceImpl> impl; ///< The API implementation wrapper.
     };
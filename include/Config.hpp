@@ -15,6 +15,16 @@ namespace WakeOnLan {
           */
         Config();
 
+        /**
+         * Config constructor for a host with a known identity. The host interfaces are not probed, so simulated
+         * hosts can be configured in the same process.
+         *
+         * @param hostname The hostname.
+         * @param ip The IP address.
+         * @param mac The MAC address.
+         */
+        Config(const std::string &hostname, const std::string &ip, const std::string &mac);
+
         /**
          * Gets the hostname.
          *
@@ -51,11 +61,324 @@ namespace WakeOnLan {
         HandlerType getHandlerType() const;
 
         void setHandlerType(HandlerType ht);
+
+        /**
+         * Gets the directory used to persist the group table.
+         *
+         * @returns A string containing the directory path. An empty string means persistence is disabled.
+         */
+        std::string getPersistenceDirectory() const;
+
+        /**
+         * Sets the directory used to persist the group table. When set, the API keeps a write-ahead log and
+         * a snapshot of the table on the directory and reloads them on startup, so a restarted manager
+         * resumes with the full group instead of rediscovering it. A participant also keeps the last known
+         * manager IP address on the directory: once restarted, it shows the recovered table marked as stale and
+         * rejoins through that manager, which confirms the table right away. Persistence is disabled by default.
+         *
+         * @param directory The directory path.
+         */
+        void setPersistenceDirectory(const std::string &directory);
+
+        /**
+         * Gets the suspicion level above which the manager considers a participant answer missed.
+         *
+         * @returns The phi threshold.
+         */
+        double getSleepSuspicionThreshold() const;
+
+        /**
+         * Sets the suspicion level above which the manager considers a participant answer missed (see
+         * ::Config::setSleepMissedAnswers()). The manager learns the arrival distribution of every
+         * participant answers, so a lower threshold detects sleeping hosts sooner and a higher one tolerates lossier
+         * links. A phi of 1 accepts a 10% chance of a missed answer, 2 accepts 1%, and so on. Default is 8.
+         *
+         * @param threshold The phi threshold.
+         */
+        void setSleepSuspicionThreshold(double threshold);
+
+        /**
+         * Gets the consecutive missed answers after which the manager marks a participant as Sleeping.
+         *
+         * @returns The number of missed answers.
+         */
+        uint32_t getSleepMissedAnswers() const;
+
+        /**
+         * Sets the consecutive missed answers after which the manager marks a participant as Sleeping. On every
+         * missed answer but the last the participant is probed again right away and given a second to answer, so a
+         * lost request or answer delays the detection by a second instead of a monitoring interval. Default is 2.
+         *
+         * @param count The number of missed answers (at least 1).
+         */
+        void setSleepMissedAnswers(uint32_t count);
+
+        /**
+         * Gets the suspicion level above which a participant considers the manager failed.
+         *
+         * @returns The phi threshold.
+         */
+        double getManagerSuspicionThreshold() const;
+
+        /**
+         * Sets the suspicion level above which a participant considers the manager failed and waits for a new
+         * discovery message. The participant learns the arrival distribution of the manager sleep status requests.
+         * Default is 8.
+         *
+         * @param threshold The phi threshold.
+         */
+        void setManagerSuspicionThreshold(double threshold);
+
+        /**
+         * Gets the monitoring mode.
+         *
+         * @returns The monitoring mode.
+         */
+        MonitoringMode getMonitoringMode() const;
+
+        /**
+         * Sets the monitoring mode. On Polling mode the manager sends a sleep status request to every participant each
+         * interval and the participants answer it. On Push mode participants send a heartbeat carrying their table
+         * sequence number to the manager each interval, and the manager only broadcasts a single heartbeat to the group,
+         * halving the monitoring traffic. Every host of the group must use the same mode. Default is Polling.
+         *
+         * @param mode The monitoring mode.
+         */
+        void setMonitoringMode(MonitoringMode mode);
+
+        /**
+         * Gets the maximum rate the manager sends sleep status requests.
+         *
+         * @returns The maximum number of requests per second. 0 means unlimited.
+         */
+        uint32_t getMaxProbeRate() const;
+
+        /**
+         * Sets the maximum rate the manager sends sleep status requests. Requests are already spread over the
+         * monitoring interval with a per-host phase and jitter; the limit additionally defers requests that would
+         * exceed the rate, so the answers arrive at a pace the listener absorbs. Default is 0 (unlimited).
+         *
+         * @param rate The maximum number of requests per second.
+         */
+        void setMaxProbeRate(uint32_t rate);
+
+        /**
+         * Gets the election mode.
+         *
+         * @returns The election mode.
+         */
+        ElectionMode getElectionMode() const;
+
+        /**
+         * Sets the election mode. On Bully mode the hosts exchange election messages and wait for answers. On
+         * FastFailover mode every host ranks the group members by IP address as the table changes, and the highest
+         * ranked live member announces itself as coordinator as soon as it detects the manager failure; the others
+         * wait for its coordinator message and fall back to a bully round if it does not arrive within the election
+         * timeout. On FastFailover mode the manager broadcasts a heartbeat every 100 ms and the lease is capped to
+         * 300 ms, and members that stop hearing the heartbeats declare the manager failure right away, so the group
+         * agrees on a new manager in under a second. Default is Bully.
+         *
+         * @param mode The election mode.
+         */
+        void setElectionMode(ElectionMode mode);
+
+        /**
+         * Gets the time an election contender waits for answers.
+         *
+         * @returns The timeout, in milliseconds.
+         */
+        uint32_t getElectionAnswerTimeout() const;
+
+        /**
+         * Sets the time an election contender waits for answers before declaring itself the winner. Default is 5000.
+         *
+         * @param timeoutMs The timeout, in milliseconds.
+         */
+        void setElectionAnswerTimeout(uint32_t timeoutMs);
+
+        /**
+         * Gets the time a host waits for the coordinator message of an election.
+         *
+         * @returns The timeout, in milliseconds.
+         */
+        uint32_t getElectionTimeout() const;
+
+        /**
+         * Sets the time a host waits for the coordinator message of an election before giving up on it. Default is
+         * 25000.
+         *
+         * @param timeoutMs The timeout, in milliseconds.
+         */
+        void setElectionTimeout(uint32_t timeoutMs);
+
+        /**
+         * Gets the manager lease duration.
+         *
+         * @returns The lease duration, in milliseconds.
+         */
+        uint32_t getLeaseDuration() const;
+
+        /**
+         * Sets the manager lease duration. The manager grants a lease on every request it already sends (sleep status
+         * requests, heartbeats and discovery requests), and a participant that stops hearing from the manager only
+         * starts an election once the lease has expired. 0 disables leases. The lease is capped to 300 ms on
+         * ElectionMode::FastFailover. Default is 20000.
+         *
+         * @param durationMs The lease duration, in milliseconds.
+         */
+        void setLeaseDuration(uint32_t durationMs);
+
+        /**
+         * Indicates a quorum must confirm the manager lease expired before an election.
+         *
+         * @returns A bool indicating the quorum check is enabled.
+         */
+        bool getLeaseQuorum() const;
+
+        /**
+         * Enables the quorum check. When the lease expires, the participant asks the other live members whether they
+         * still hold a lease. The election only starts when a majority of the group confirms the expiry and no
+         * member still holds a lease; otherwise the participant keeps waiting for the manager. Default is false.
+         *
+         * @param enabled A bool indicating the quorum check is enabled.
+         */
+        void setLeaseQuorum(bool enabled);
+
+        /**
+         * Gets the IP address of the designated standby manager.
+         *
+         * @returns The standby IP address (empty when disabled).
+         */
+        std::string getStandby() const;
+
+        /**
+         * Designates a hot standby for the manager. The manager replicates every table update to the standby and waits
+         * for its acknowledgement before multicasting the update, and the standby wins the election when the manager
+         * fails, so it takes over with a current table. Every host of the group must designate the same standby.
+         * Default is empty (disabled).
+         *
+         * @param ip The standby IP address.
+         */
+        void setStandby(const std::string &ip);
+
+        /**
+         * Gets the maximum interval between two discovery requests of the manager.
+         *
+         * @returns The interval, in milliseconds.
+         */
+        uint32_t getMaxDiscoveryInterval() const;
+
+        /**
+         * Sets the maximum interval between two discovery requests of the manager. A manager starts broadcasting
+         * discovery requests every 500 ms and doubles the interval after each request, up to the maximum, while the
+         * group is stable; a join or an exit resets it to 500 ms. A host that never joined the group waits for a discovery
+         * request up to the maximum interval (plus 2 s of grace) before declaring the manager failed, so every host of the
+         * group must use the same value. Default is 30000.
+         *
+         * @param intervalMs The interval, in milliseconds.
+         */
+        void setMaxDiscoveryInterval(uint32_t intervalMs);
+
+        /**
+         * Gets the port the API messages are exchanged on.
+         *
+         * @returns The service port.
+         */
+        uint16_t getServicePort() const;
+
+        /**
+         * Sets the UDP port the API messages are exchanged on. Every host of the group must use the same port.
+         * Default is 4000.
+         *
+         * @param port The service port.
+         */
+        void setServicePort(uint16_t port);
+
+        /**
+         * Gets the port the magic packets are sent to.
+         *
+         * @returns The Wake-on-LAN port.
+         */
+        uint16_t getWakeOnLanPort() const;
+
+        /**
+         * Sets the UDP port the magic packets are broadcast to. Default is 9 (discard).
+         *
+         * @param port The Wake-on-LAN port.
+         */
+        void setWakeOnLanPort(uint16_t port);
+
+        /**
+         * Gets the transport used to exchange the API messages.
+         *
+         * @returns The transport type.
+         */
+        TransportType getTransportType() const;
+
+        /**
+         * Sets the transport used to exchange the API messages. _TransportType::UnixDatagram_ lets hosts sharing a
+         * file system (e.g. agents on containers of the same machine) talk through Unix sockets on the Unix socket
+         * directory, without going through the IP stack. Every host of the group must use the same transport.
+         * Default is Udp.
+         *
+         * @param type The transport type.
+         */
+        void setTransportType(TransportType type);
+
+        /**
+         * Gets the directory holding the sockets of the Unix datagram transport.
+         *
+         * @returns The directory path.
+         */
+        std::string getUnixSocketDirectory() const;
+
+        /**
+         * Sets the directory holding the sockets of the Unix datagram transport. Every host binds a socket named by
+         * its IP address on it. Default is "/tmp/wakeonlan".
+         *
+         * @param directory The directory path.
+         */
+        void setUnixSocketDirectory(const std::string &directory);
+
+        /**
+         * Indicates the API runs headless, without the terminal interface.
+         *
+         * @returns A bool indicating the headless mode is enabled.
+         */
+        bool getHeadless() const;
+
+        /**
+         * Enables the headless mode, for hosts running the API as a daemon without a terminal (e.g. a systemd
+         * service). The terminal interface is never started: no banner, no command reader on the standard input
+         * and no table rendering. Front ends follow the group through ::ApiInstance::waitForTableChanges() instead.
+         * Default is false.
+         *
+         * @param headless A bool indicating the headless mode is enabled.
+         */
+        void setHeadless(bool headless);
     private:
         HandlerType handlerType; ///< The configured handler type. Default is Participant.
         std::string hostname;    ///< The hostname of the local host.
         std::string ip;          ///< The local host IP address.
         std::string mac;         ///< The local host MAC address.
         std::string interface;   ///< The local host interface for receiving incoming packets.
+        std::string persistenceDirectory; ///< The directory used to persist the table (empty when disabled).
+        double sleepSuspicionThreshold;   ///< The phi above which a participant answer is considered missed.
+        uint32_t sleepMissedAnswers;      ///< The consecutive missed answers marking a participant as Sleeping.
+        double managerSuspicionThreshold; ///< The phi above which the manager is considered failed.
+        MonitoringMode monitoringMode;    ///< The monitoring mode. Default is Polling.
+        uint32_t maxProbeRate;            ///< The maximum sleep status requests per second (0 when unlimited).
+        ElectionMode electionMode;        ///< The election mode. Default is Bully.
+        uint32_t electionAnswerTimeout;   ///< The time (ms) a contender waits for answers.
+        uint32_t electionTimeout;         ///< The time (ms) a host waits for the coordinator message.
+        uint32_t leaseDuration;           ///< The manager lease duration (ms). 0 when disabled.
+        bool leaseQuorum;                 ///< Indicates a quorum must confirm the lease expiry.
+        std::string standby;              ///< The designated standby IP address (empty when disabled).
+        uint32_t maxDiscoveryInterval;    ///< The maximum interval (ms) between two discovery requests.
+        uint16_t servicePort;             ///< The port the API messages are exchanged on.
+        uint16_t wakeOnLanPort;           ///< The port the magic packets are sent to.
+        TransportType transportType;      ///< The transport. Default is Udp.
+        std::string unixSocketDirectory;  ///< The directory holding the Unix datagram sockets.
+        bool headless;                    ///< Indicates the terminal interface is not run.
     };
 } // namespace WakeOnLan
@@ -1,4 +1,7 @@
 #pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
 
 namespace WakeOnLan {
     /**
@@ -9,4 +12,107 @@ namespace WakeOnLan {
         Manager = 0,      ///< Manager handler option.
         Participant = 1   ///< Participant handler option.
     };
-} // namespace WakeOnLan
\ No newline at end of file
+
+    /**
+     * @enum MonitoringMode
+     * How the manager learns the participants are awake.
+     */
+    enum class MonitoringMode {
+        Polling = 0,    ///< The manager sends a SleepStatusRequest to every participant, which answers it.
+        Push = 1        ///< Participants send periodic heartbeats to the manager, which broadcasts a single heartbeat.
+    };
+
+    /**
+     * @enum ElectionMode
+     * How a new manager is elected when the manager fails.
+     */
+    enum class ElectionMode {
+        Bully = 0,          ///< Hosts exchange election and answer messages; the highest ranked one that answers wins.
+        FastFailover = 1    ///< The highest ranked live member announces itself as coordinator without a bully round.
+    };
+
+    /**
+     * @enum TransportType
+     * How the hosts exchange the API messages.
+     */
+    enum class TransportType {
+        Udp = 0,            ///< UDP datagrams on the service port.
+        UnixDatagram = 1    ///< Unix datagram sockets on a shared directory, for hosts sharing a file system.
+    };
+
+    /**
+     * @enum MemberStatus
+     * The status of a group member, as seen by the manager.
+     */
+    enum class MemberStatus {
+        Awaken = 0,     ///< The member is answering to the services requests.
+        Sleeping = 1,   ///< The member is part of the group and is not answering to the service requests.
+        Unknown = 2,    ///< The member joined the group and was not probed yet.
+        Manager = 3     ///< The member is the group manager.
+    };
+
+    /**
+     * @struct Member
+     * A group member.
+     */
+    struct Member {
+        std::string hostname;           ///< The member hostname.
+        std::string ip;                 ///< The member IP address.
+        std::string mac;                ///< The member MAC address.
+        std::string electedTimestamp;   ///< The time the member was elected manager ("N/A" when never elected).
+        MemberStatus status;            ///< The member status.
+    };
+
+    /**
+     * @enum TableChangeType
+     * The kind of change applied to a group member.
+     */
+    enum class TableChangeType {
+        Inserted = 0,   ///< The member joined the group.
+        Updated = 1,    ///< The member row was updated.
+        Removed = 2     ///< The member left the group.
+    };
+
+    /**
+     * @struct TableChange
+     * A change applied to a group member.
+     */
+    struct TableChange {
+        TableChangeType type;   ///< The kind of change.
+        Member member;          ///< The changed member (only the hostname is meaningful for Removed).
+    };
+
+    /**
+     * @struct TableChanges
+     * The changes applied to the group table after a given version.
+     */
+    struct TableChanges {
+        uint64_t version;                   ///< The table version to pass on the next call.
+        bool reset;                         ///< Indicates the caller must drop its view before applying the changes.
+        bool stale;                         ///< Indicates the group is a cached copy not confirmed by the manager yet.
+        std::vector<TableChange> changes;   ///< The changes, in the order they were applied.
+    };
+
+    /**
+     * @struct LatencyHistogram
+     * A latency distribution, in milliseconds.
+     */
+    struct LatencyHistogram {
+        std::vector<uint64_t> bounds;   ///< The inclusive upper bound of each bucket, in milliseconds.
+        std::vector<uint64_t> counts;   ///< The samples of each bucket. The last bucket counts samples above every bound.
+        uint64_t count;                 ///< The number of samples.
+        uint64_t sum;                   ///< The sum of the samples.
+        uint64_t min;                   ///< The smallest sample (0 when there is no sample).
+        uint64_t max;                   ///< The largest sample.
+    };
+
+    /**
+     * @struct ElectionStats
+     * The elections observed by the local host.
+     */
+    struct ElectionStats {
+        uint64_t noElections;           ///< The elections that ended with a coordinator.
+        uint64_t noTimeouts;            ///< The elections that timed-out without a coordinator.
+        LatencyHistogram latency;       ///< The time from the election start to the coordinator announcement.
+    };
+} // namespace WakeOnLan
@@ -21,4 +21,16 @@ namespace WakeOnLan {
     void ApiInstance::stop() {
         impl->stop();
     }
+
+    TableChanges ApiInstance::waitForTableChanges(uint64_t version, uint32_t timeoutMs) {
+        return impl->waitForTableChanges(version, timeoutMs);
+    }
+
+    ElectionStats ApiInstance::getElectionStats() {
+        return impl->getElectionStats();
+    }
+
+    bool ApiInstance::announceSleep() {
+        return impl->announceSleep();
+    }
 }
\ No newline at end of file
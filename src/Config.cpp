@@ -15,7 +15,23 @@ namespace WakeOnLan {
     };
 
     Config::Config()
-            : handlerType(Participant) {
+            : handlerType(Participant),
+              sleepSuspicionThreshold(8.0),
+              sleepMissedAnswers(2),
+              managerSuspicionThreshold(8.0),
+              monitoringMode(MonitoringMode::Polling),
+              maxProbeRate(0),
+              electionMode(ElectionMode::Bully),
+              electionAnswerTimeout(5000),
+              electionTimeout(25000),
+              leaseDuration(20000),
+              leaseQuorum(false),
+              maxDiscoveryInterval(30000),
+              servicePort(4000),
+              wakeOnLanPort(9),
+              transportType(TransportType::Udp),
+              unixSocketDirectory("/tmp/wakeonlan"),
+              headless(false) {
         try {
             /* Get the host currently-active interface */
             std::ifstream ifs;
@@ -62,6 +78,28 @@ namespace WakeOnLan {
         }
     }
 
+    Config::Config(const std::string &hostname, const std::string &ip, const std::string &mac)
+            : handlerType(Participant),
+              hostname(hostname),
+              ip(ip),
+              mac(mac),
+              sleepSuspicionThreshold(8.0),
+              sleepMissedAnswers(2),
+              managerSuspicionThreshold(8.0),
+              monitoringMode(MonitoringMode::Polling),
+              maxProbeRate(0),
+              electionMode(ElectionMode::Bully),
+              electionAnswerTimeout(5000),
+              electionTimeout(25000),
+              leaseDuration(20000),
+              leaseQuorum(false),
+              maxDiscoveryInterval(30000),
+              servicePort(4000),
+              wakeOnLanPort(9),
+              transportType(TransportType::Udp),
+              unixSocketDirectory("/tmp/wakeonlan"),
+              headless(false) {}
+
     std::string Config::getIface() const { return interface; }
 
     std::string Config::getHostname() const { return hostname; }
@@ -73,4 +111,76 @@ namespace WakeOnLan {
     HandlerType Config::getHandlerType() const { return handlerType; }
 
     void Config::setHandlerType(HandlerType ht) { handlerType = ht; }
-}
\ No newline at end of file
+
+    std::string Config::getPersistenceDirectory() const { return persistenceDirectory; }
+
+    void Config::setPersistenceDirectory(const std::string &directory) { persistenceDirectory = directory; }
+
+    double Config::getSleepSuspicionThreshold() const { return sleepSuspicionThreshold; }
+
+    void Config::setSleepSuspicionThreshold(double threshold) { sleepSuspicionThreshold = threshold; }
+
+    uint32_t Config::getSleepMissedAnswers() const { return sleepMissedAnswers; }
+
+    void Config::setSleepMissedAnswers(uint32_t count) { sleepMissedAnswers = std::max<uint32_t>(count, 1); }
+
+    double Config::getManagerSuspicionThreshold() const { return managerSuspicionThreshold; }
+
+    void Config::setManagerSuspicionThreshold(double threshold) { managerSuspicionThreshold = threshold; }
+
+    MonitoringMode Config::getMonitoringMode() const { return monitoringMode; }
+
+    void Config::setMonitoringMode(MonitoringMode mode) { monitoringMode = mode; }
+
+    uint32_t Config::getMaxProbeRate() const { return maxProbeRate; }
+
+    void Config::setMaxProbeRate(uint32_t rate) { maxProbeRate = rate; }
+
+    ElectionMode Config::getElectionMode() const { return electionMode; }
+
+    void Config::setElectionMode(ElectionMode mode) { electionMode = mode; }
+
+    uint32_t Config::getElectionAnswerTimeout() const { return electionAnswerTimeout; }
+
+    void Config::setElectionAnswerTimeout(uint32_t timeoutMs) { electionAnswerTimeout = timeoutMs; }
+
+    uint32_t Config::getElectionTimeout() const { return electionTimeout; }
+
+    void Config::setElectionTimeout(uint32_t timeoutMs) { electionTimeout = timeoutMs; }
+
+    uint32_t Config::getLeaseDuration() const { return leaseDuration; }
+
+    void Config::setLeaseDuration(uint32_t durationMs) { leaseDuration = durationMs; }
+
+    bool Config::getLeaseQuorum() const { return leaseQuorum; }
+
+    void Config::setLeaseQuorum(bool enabled) { leaseQuorum = enabled; }
+
+    std::string Config::getStandby() const { return standby; }
+
+    void Config::setStandby(const std::string &ip) { standby = ip; }
+
+    uint32_t Config::getMaxDiscoveryInterval() const { return maxDiscoveryInterval; }
+
+    void Config::setMaxDiscoveryInterval(uint32_t intervalMs) { maxDiscoveryInterval = intervalMs; }
+
+    uint16_t Config::getServicePort() const { return servicePort; }
+
+    void Config::setServicePort(uint16_t port) { servicePort = port; }
+
+    uint16_t Config::getWakeOnLanPort() const { return wakeOnLanPort; }
+
+    void Config::setWakeOnLanPort(uint16_t port) { wakeOnLanPort = port; }
+
+    TransportType Config::getTransportType() const { return transportType; }
+
+    void Config::setTransportType(TransportType type) { transportType = type; }
+
+    std::string Config::getUnixSocketDirectory() const { return unixSocketDirectory; }
+
+    void Config::setUnixSocketDirectory(const std::string &directory) { unixSocketDirectory = directory; }
+
+    bool Config::getHeadless() const { return headless; }
+
+    void Config::setHeadless(bool enabled) { headless = enabled; }
+}
@@ -9,6 +9,9 @@ namespace WakeOnLanImpl {
 #define WAKEONLAN_FIELD_IP_SIZE 150
 #define WAKEONLAN_FIELD_MAC_SIZE 17
 #define WAKEONLAN_FIELD_STATUS_SIZE 1
+#define WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES 4
+#define WAKEONLAN_LEASE_QUERY 1
+#define WAKEONLAN_LEASE_REPLY 2
 #pragma pack(push, 1)
 
 /**
@@ -23,11 +26,54 @@ enum class Type {
     ElectionServiceCoordinator = 'C', ///< Indicates the message is a ElectionService coordinator message.
     ElectionServiceAnswer = 'A',      ///< Indicates the message is a ElectionService answer message.
     Unknown = 'U'  ,                  ///< Indicates a unknown type was parsed.
-    TableUpdate = 'T'               ///< Indicates the message contains a table update.
+    TableUpdate = 'T',                ///< Indicates the message contains a table update.
+    TableUpdateNack = 'N',            ///< Indicates the message requests the retransmission of missed table updates.
+    Heartbeat = 'H',                  ///< Indicates the message is a monitoring heartbeat (push monitoring mode).
+    LeaseQuery = 'Q',                 ///< Indicates the message asks a peer whether it holds a valid manager lease.
+    StandbyAck = 'K',                 ///< Indicates the standby applied the table updates up to the message sequence number.
+    SleepNotice = 'S'                 ///< Indicates the sender is about to suspend.
 };
 
+/**
+ * @struct TableUpdateHeader
+ * The header of a TableUpdate message. A table update is split in fragments of up
+ * to WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES entries sharing the same sequence number.
+ */
 struct TableUpdateHeader {
     uint8_t noEntries;              ///< Number of table entries contained on the message.
+    uint16_t fragment;              ///< Index of the fragment on the update.
+    uint16_t noFragments;           ///< Number of fragments composing the update.
+    uint32_t epoch;                 ///< The manager epoch, drawn when the host becomes manager. Sequence numbers are only comparable within an epoch.
+};
+
+/**
+ * @struct TableUpdateNack
+ * The payload of a TableUpdateNack message. The message sequence number holds the
+ * first missed update and the payload holds the last one.
+ */
+struct TableUpdateNack {
+    uint32_t lastSeqNum;            ///< The last sequence number of the missed range.
+};
+
+/**
+ * @struct ManagerLease
+ * The payload of the manager SleepStatusRequest, Heartbeat and SleepServiceDiscovery requests, and of the
+ * LeaseQuery replies. A request grants the receiver a lease on the manager leadership, counted from its arrival.
+ * Peers running without leases send a zeroed payload, which grants no lease.
+ */
+struct ManagerLease {
+    uint32_t duration;              ///< The lease duration (or the remaining lease on a LeaseQuery reply), in milliseconds.
+};
+
+/**
+ * @struct TableDigest
+ * The payload following the ManagerLease on the manager SleepStatusRequest and Heartbeat requests. It lets a
+ * participant check its table matches the manager one without any table transfer. A zeroed payload carries no digest.
+ */
+struct TableDigest {
+    uint32_t seqNum;                ///< The manager table sequence number.
+    uint32_t epoch;                 ///< The manager epoch the sequence number belongs to (see ::TableUpdateHeader).
+    uint64_t digest;                ///< The digest of the manager table rows at the sequence number.
 };
 
 /**
@@ -36,11 +82,11 @@ struct TableUpdateHeader {
  */
 struct Message {
     Type type;                                        ///< The message type.
-    uint32_t msgSeqNum;                               ///< The message sequence number (used by Discovery service and TableUpdate).
+    uint32_t msgSeqNum;                               ///< The message sequence number (used by Discovery service, TableUpdate, Heartbeat and StandbyAck).
     char hostname[WAKEONLAN_FIELD_HOSTNAME_SIZE];     ///< The source/destination hostname.
     char ip[WAKEONLAN_FIELD_IP_SIZE];                 ///< The source/destination IP address.
     char mac[WAKEONLAN_FIELD_MAC_SIZE];               ///< The source/destination MAC address.
-    char data[sizeof(TableUpdateHeader) + 4 *
+    char data[sizeof(TableUpdateHeader) + WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES *
             ( WAKEONLAN_FIELD_TIMESTAMP_SIZE
               + WAKEONLAN_FIELD_HOSTNAME_SIZE
               + WAKEONLAN_FIELD_IP_SIZE
@@ -59,6 +105,16 @@ inline std::ostream& operator<<(std::ostream &os, const Message &message) {
                 return "SleepStatusRequest\n";
             case Type::SleepServiceExit:
                 return "SleepServiceExit\n";
+            case Type::TableUpdate:
+                return "TableUpdate\n";
+            case Type::TableUpdateNack:
+                return "TableUpdateNack\n";
+            case Type::Heartbeat:
+                return "Heartbeat\n";
+            case Type::LeaseQuery:
+                return "LeaseQuery\n";
+            case Type::StandbyAck:
+                return "StandbyAck\n";
             default:
                 return "";
         }
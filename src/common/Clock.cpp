@@ -0,0 +1,109 @@
+#include <chrono>
+#include <ctime>
+#include <../src/common/Clock.hpp>
+
+namespace WakeOnLanImpl {
+#define WAKEONLAN_CLOCK_SUSPEND_RESOLUTION 10
+#define WAKEONLAN_VIRTUAL_CLOCK_POLL 100
+
+    /**
+     * Reads a POSIX clock, in milliseconds.
+     */
+    static uint64_t readClock(clockid_t id) {
+        struct timespec ts{};
+        clock_gettime(id, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    bool Clock::suspendedSince(uint64_t &mark) {
+        /* Both clocks are read back to back, so a small difference is only the reading skew */
+        uint64_t suspended = suspendedTime();
+        if (suspended < mark + WAKEONLAN_CLOCK_SUSPEND_RESOLUTION)
+            return false;
+        mark = suspended;
+        return true;
+    }
+
+    void Clock::sleepUntil(uint64_t deadline) {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::unique_lock<std::mutex> lk(mutex);
+        waitUntil(cv, lk, deadline, []() { return false; });
+    }
+
+    std::shared_ptr<Clock> Clock::system() {
+        static std::shared_ptr<Clock> instance = std::make_shared<SteadyClock>();
+        return instance;
+    }
+
+    uint64_t SteadyClock::now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t SteadyClock::suspendedTime() {
+#ifdef CLOCK_BOOTTIME
+        uint64_t boottime = readClock(CLOCK_BOOTTIME);
+        uint64_t monotonic = readClock(CLOCK_MONOTONIC);
+        return boottime > monotonic ? boottime - monotonic : 0;
+#else
+        return 0;
+#endif
+    }
+
+    bool SteadyClock::waitUntil(std::condition_variable &cv,
+                                std::unique_lock<std::mutex> &lk,
+                                uint64_t deadline,
+                                const std::function<bool()> &predicate) {
+        return cv.wait_until(lk, std::chrono::steady_clock::time_point(std::chrono::milliseconds(deadline)), predicate);
+    }
+
+    VirtualClock::VirtualClock(uint64_t start)
+        : time(start),
+          suspended(0)
+    {}
+
+    uint64_t VirtualClock::now() {
+        return time.load();
+    }
+
+    uint64_t VirtualClock::suspendedTime() {
+        return suspended.load();
+    }
+
+    bool VirtualClock::waitUntil(std::condition_variable &cv,
+                                 std::unique_lock<std::mutex> &lk,
+                                 uint64_t deadline,
+                                 const std::function<bool()> &predicate) {
+        std::list<Waiter>::iterator waiter;
+        {
+            std::lock_guard<std::mutex> wlk(waitersMutex);
+            waiter = waiters.insert(waiters.end(), Waiter{&cv, deadline});
+        }
+
+        bool result = true;
+        while (!predicate()) {
+            if (now() >= deadline) {
+                result = false;
+                break;
+            }
+            cv.wait_for(lk, std::chrono::milliseconds(WAKEONLAN_VIRTUAL_CLOCK_POLL));
+        }
+
+        std::lock_guard<std::mutex> wlk(waitersMutex);
+        waiters.erase(waiter);
+        return result;
+    }
+
+    void VirtualClock::advance(uint64_t ms) {
+        uint64_t current = time += ms;
+        std::lock_guard<std::mutex> lk(waitersMutex);
+        for (auto &waiter : waiters)
+            if (waiter.deadline <= current)
+                waiter.cv->notify_all();
+    }
+
+    void VirtualClock::suspend(uint64_t ms) {
+        suspended += ms;
+    }
+} // namespace WakeOnLanImpl
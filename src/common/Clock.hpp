@@ -0,0 +1,144 @@
+#pragma once
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+namespace WakeOnLanImpl {
+    /**
+     * @class Clock
+     * This class is the time source of the API services. Deadlines are kept in milliseconds of a monotonic
+     * clock, so they are not affected by wall-clock adjustments, and host suspend is reported as the time the host
+     * spent suspended. A clock is injected on the ::NetworkHandler and shared by every service through it, so the
+     * services can run on the ::SteadyClock or on a ::VirtualClock driven by a simulation.
+     */
+    class Clock {
+    public:
+        /**
+         * Clock virtual destructor.
+         */
+        virtual ~Clock() = default;
+
+        /**
+         * Gets the current time of the monotonic clock.
+         * @returns The time, in milliseconds.
+         */
+        virtual uint64_t now() = 0;
+
+        /**
+         * Gets the time the host spent suspended.
+         * @returns The suspended time, in milliseconds.
+         */
+        virtual uint64_t suspendedTime() = 0;
+
+        /**
+         * Indicates the host was suspended since the mark passed as argument was taken. The mark is updated, so
+         * successive calls report each suspend once.
+         * @param mark The suspended time observed on the last call (initialize it with ::suspendedTime()).
+         * @returns A bool indicating the host was suspended.
+         */
+        bool suspendedSince(uint64_t &mark);
+
+        /**
+         * Blocks the calling thread until the deadline passes, without consuming CPU.
+         * @param deadline The deadline, in milliseconds of this clock.
+         * @returns None.
+         */
+        void sleepUntil(uint64_t deadline);
+
+        /**
+         * Blocks on a condition variable until the predicate holds or the deadline passes, without consuming CPU.
+         * @param cv The condition variable notified when the predicate may have changed.
+         * @param lk The lock held by the caller, protecting the predicate state.
+         * @param deadline The deadline, in milliseconds of this clock.
+         * @param predicate The condition waited for.
+         * @returns The predicate value when the wait ends.
+         */
+        virtual bool waitUntil(std::condition_variable &cv,
+                               std::unique_lock<std::mutex> &lk,
+                               uint64_t deadline,
+                               const std::function<bool()> &predicate) = 0;
+
+        /**
+         * Gets the system clock shared by the API instances.
+         * @returns A shared pointer to the ::SteadyClock.
+         */
+        static std::shared_ptr<Clock> system();
+    };
+
+    /**
+     * @class SteadyClock
+     * The system clock. The time comes from steady_clock, and suspend is detected by comparing CLOCK_BOOTTIME,
+     * which keeps counting while the host is suspended, with CLOCK_MONOTONIC, which does not: the difference between
+     * them only grows while the host sleeps.
+     */
+    class SteadyClock : public Clock {
+    public:
+        uint64_t now() override;
+        uint64_t suspendedTime() override;
+        bool waitUntil(std::condition_variable &cv,
+                       std::unique_lock<std::mutex> &lk,
+                       uint64_t deadline,
+                       const std::function<bool()> &predicate) override;
+    };
+
+    /**
+     * @class VirtualClock
+     * A clock that only moves when told to. Simulations and benchmarks advance it instantly, so protocol scenarios
+     * that take tens of seconds of real time (discovery, a sleep/awake cycle, a manager failover) complete as fast as
+     * the services threads react. The class is thread-safe.
+     */
+    class VirtualClock : public Clock {
+    public:
+        /**
+         * VirtualClock constructor.
+         * @param start The initial time, in milliseconds.
+         */
+        explicit VirtualClock(uint64_t start = 0);
+
+        uint64_t now() override;
+        uint64_t suspendedTime() override;
+
+        /**
+         * Waits for the predicate until the virtual deadline. Since the deadline only passes when the clock
+         * is advanced, ::advance() wakes up the waiters whose deadline passed. A waiter missing an advance that
+         * raced with the start of the wait is woken by the next one; waiters also recheck the time every
+         * WAKEONLAN_VIRTUAL_CLOCK_POLL milliseconds of real time, in case the clock stopped advancing. The recheck
+         * is kept rare, since every host of a simulated group has several waiting threads.
+         */
+        bool waitUntil(std::condition_variable &cv,
+                       std::unique_lock<std::mutex> &lk,
+                       uint64_t deadline,
+                       const std::function<bool()> &predicate) override;
+
+        /**
+         * Advances the time.
+         * @param ms The elapsed time, in milliseconds.
+         */
+        void advance(uint64_t ms);
+
+        /**
+         * Simulates a host suspend. The suspended time grows while the monotonic time does not move,
+         * as happens with CLOCK_MONOTONIC on a real suspend.
+         * @param ms The time spent suspended, in milliseconds.
+         */
+        void suspend(uint64_t ms);
+    private:
+        /**
+         * @struct Waiter
+         * A thread blocked on ::waitUntil().
+         */
+        struct Waiter {
+            std::condition_variable *cv;    ///< The condition variable the thread waits on.
+            uint64_t deadline;              ///< The deadline of the wait.
+        };
+
+        std::atomic<uint64_t> time;         ///< The current time.
+        std::atomic<uint64_t> suspended;    ///< The time spent suspended.
+        std::mutex waitersMutex;            ///< The mutex guarding the waiters.
+        std::list<Waiter> waiters;          ///< The threads blocked on ::waitUntil().
+    };
+} // namespace WakeOnLanImpl
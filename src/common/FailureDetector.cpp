@@ -0,0 +1,92 @@
+#include <cmath>
+#include <algorithm>
+#include <../src/common/FailureDetector.hpp>
+
+namespace WakeOnLanImpl {
+#define WAKEONLAN_FAILURE_DETECTOR_WINDOW 100
+#define WAKEONLAN_FAILURE_DETECTOR_MAX_PHI 30.0
+
+    FailureDetector::FailureDetector(uint64_t expected, uint64_t minStdDev)
+        : expectedInterval(expected ? expected : 1),
+          minStdDeviation(minStdDev ? minStdDev : 1),
+          lastArrival(0),
+          hasArrival(false),
+          sum(0),
+          squaredSum(0)
+    {}
+
+    void FailureDetector::heartbeat(uint64_t now) {
+        if (!hasArrival || now < lastArrival) {
+            restart(now);
+            return;
+        }
+
+        uint64_t interval = now - lastArrival;
+        intervals.push_back(interval);
+        sum += interval;
+        squaredSum += static_cast<double>(interval) * interval;
+        if (intervals.size() > WAKEONLAN_FAILURE_DETECTOR_WINDOW) {
+            sum -= intervals.front();
+            squaredSum -= static_cast<double>(intervals.front()) * intervals.front();
+            intervals.pop_front();
+        }
+        lastArrival = now;
+    }
+
+    void FailureDetector::restart(uint64_t now) {
+        lastArrival = now;
+        hasArrival = true;
+    }
+
+    bool FailureDetector::started() const {
+        return hasArrival;
+    }
+
+    double FailureDetector::mean() const {
+        if (intervals.empty())
+            return expectedInterval;
+        return sum / intervals.size();
+    }
+
+    double FailureDetector::stdDeviation() const {
+        /* Until samples are collected, the deviation is a quarter of the expected interval */
+        double deviation = expectedInterval / 4.0;
+        if (intervals.size() > 1) {
+            double m = mean();
+            deviation = std::sqrt(std::max(0.0, squaredSum / intervals.size() - m * m));
+        }
+        return std::max(deviation, static_cast<double>(minStdDeviation));
+    }
+
+    double FailureDetector::phi(double elapsed) const {
+        /* Logistic approximation of the normal CDF, as used by the phi-accrual detector of Akka and Cassandra */
+        double y = (elapsed - mean()) / stdDeviation();
+        double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+        double p = elapsed > mean() ? e / (1.0 + e) : 1.0 - 1.0 / (1.0 + e);
+        if (p <= 0)
+            return WAKEONLAN_FAILURE_DETECTOR_MAX_PHI;
+        return std::min(-std::log10(p), WAKEONLAN_FAILURE_DETECTOR_MAX_PHI);
+    }
+
+    double FailureDetector::phi(uint64_t now) const {
+        if (!hasArrival || now <= lastArrival)
+            return 0;
+        return phi(static_cast<double>(now - lastArrival));
+    }
+
+    uint64_t FailureDetector::deadline(double threshold) const {
+        /* phi grows with the elapsed time, so the crossing point is found by bisection */
+        double low = 0;
+        double high = mean() + stdDeviation();
+        while (phi(high) < threshold && high < 1e12)
+            high *= 2;
+        for (int i = 0; i < 64 && high - low > 1; i++) {
+            double middle = (low + high) / 2;
+            if (phi(middle) < threshold)
+                low = middle;
+            else
+                high = middle;
+        }
+        return lastArrival + static_cast<uint64_t>(std::ceil(high));
+    }
+} // namespace WakeOnLanImpl
@@ -0,0 +1,71 @@
+#pragma once
+#include <deque>
+#include <cstdint>
+
+namespace WakeOnLanImpl {
+    /**
+     * @class FailureDetector
+     * This class implements a phi-accrual failure detector. Instead of a fixed timeout, it keeps a sliding window
+     * of the inter-arrival times of the messages received from a peer and reports a suspicion level (phi) that grows
+     * with the time elapsed since the last arrival, relative to the learned distribution. A phi of 1 means a 10% chance
+     * of being wrong when suspecting the peer, a phi of 2 means 1%, and so on. Peers on stable links are suspected soon
+     * after a missing message, while peers with a jittery history are given a proportionally longer grace.
+     *
+     * The class is not thread-safe.
+     */
+    class FailureDetector {
+    public:
+        /**
+         * FailureDetector constructor.
+         * @param expectedInterval The expected inter-arrival time, in milliseconds, used until samples are collected.
+         * @param minStdDeviation The minimum standard deviation, in milliseconds, so a perfectly regular peer is not
+         * suspected on the first late message.
+         */
+        FailureDetector(uint64_t expectedInterval, uint64_t minStdDeviation);
+
+        /**
+         * Records a message arrival, adding the interval since the previous arrival to the window.
+         * @param now The arrival time, in milliseconds.
+         */
+        void heartbeat(uint64_t now);
+
+        /**
+         * Restarts the detection from the time passed as argument without sampling the elapsed interval
+         * (e.g. the first arrival or the peer waking up). The learned window is kept.
+         * @param now The arrival time, in milliseconds.
+         */
+        void restart(uint64_t now);
+
+        /**
+         * Indicates a message has arrived since the detector was created.
+         * @returns A bool indicating ::phi() is meaningful.
+         */
+        bool started() const;
+
+        /**
+         * Gets the suspicion level of the peer.
+         * @param now The current time, in milliseconds.
+         * @returns The phi value. It is 0 when no message has arrived yet.
+         */
+        double phi(uint64_t now) const;
+
+        /**
+         * Gets the time at which the suspicion level reaches the threshold if no message arrives.
+         * @param threshold The phi threshold.
+         * @returns The deadline, in milliseconds.
+         */
+        uint64_t deadline(double threshold) const;
+    private:
+        double mean() const;
+        double stdDeviation() const;
+        double phi(double elapsed) const;
+
+        uint64_t expectedInterval;          ///< The interval assumed before samples are collected.
+        uint64_t minStdDeviation;           ///< The lower bound of the standard deviation.
+        uint64_t lastArrival;               ///< The time of the last arrival.
+        bool hasArrival;                    ///< Indicates a message has arrived.
+        std::deque<uint64_t> intervals;     ///< The sliding window of inter-arrival times.
+        double sum;                         ///< The sum of the window intervals.
+        double squaredSum;                  ///< The sum of the squared window intervals.
+    };
+} // namespace WakeOnLanImpl
@@ -0,0 +1,33 @@
+#include <algorithm>
+#include <../src/common/Histogram.hpp>
+
+namespace WakeOnLanImpl {
+#define WAKEONLAN_HISTOGRAM_MAX_BOUND 60000
+
+    Histogram::Histogram() {
+        for (uint64_t decade = 1; decade <= WAKEONLAN_HISTOGRAM_MAX_BOUND; decade *= 10)
+            for (uint64_t step : {1, 2, 5})
+                if (decade * step <= WAKEONLAN_HISTOGRAM_MAX_BOUND)
+                    histogram.bounds.push_back(decade * step);
+        histogram.counts.assign(histogram.bounds.size() + 1, 0);
+        histogram.count = 0;
+        histogram.sum = 0;
+        histogram.min = 0;
+        histogram.max = 0;
+    }
+
+    void Histogram::record(uint64_t ms) {
+        std::lock_guard<std::mutex> lk(mutex);
+        auto it = std::lower_bound(histogram.bounds.begin(), histogram.bounds.end(), ms);
+        histogram.counts[it - histogram.bounds.begin()]++;
+        histogram.min = histogram.count ? std::min(histogram.min, ms) : ms;
+        histogram.max = std::max(histogram.max, ms);
+        histogram.sum += ms;
+        histogram.count++;
+    }
+
+    WakeOnLan::LatencyHistogram Histogram::get() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return histogram;
+    }
+} // namespace WakeOnLanImpl
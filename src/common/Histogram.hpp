@@ -0,0 +1,35 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <../include/Types.hpp>
+
+namespace WakeOnLanImpl {
+    /**
+     * @class Histogram
+     * This class records latencies on fixed buckets following a 1-2-5 progression, from 1 millisecond to 1 minute.
+     * The class is thread-safe.
+     */
+    class Histogram {
+    public:
+        /**
+         * Histogram constructor.
+         */
+        Histogram();
+
+        /**
+         * Records a sample.
+         * @param ms The latency, in milliseconds.
+         */
+        void record(uint64_t ms);
+
+        /**
+         * Gets a copy of the recorded distribution.
+         * @returns The distribution.
+         */
+        WakeOnLan::LatencyHistogram get();
+    private:
+        std::mutex mutex;                       ///< The mutex guarding the distribution.
+        WakeOnLan::LatencyHistogram histogram;  ///< The distribution.
+    };
+} // namespace WakeOnLanImpl
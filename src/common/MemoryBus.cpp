@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+#include <../src/common/MemoryBus.hpp>
+
+namespace WakeOnLanImpl {
+#define WAKEONLAN_BUS_BROADCAST_ADDRESS "255.255.255.255"
+#define WAKEONLAN_BUS_NO_DELIVERY UINT64_MAX
+
+    MemoryBus::Endpoint::~Endpoint() {
+        Incoming *node = incoming.load();
+        while (node != nullptr) {
+            Incoming *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    MemoryBus::MemoryBus(std::shared_ptr<Clock> clk, uint32_t s, size_t max)
+        : clock(clk ? clk : Clock::system()),
+          maxHosts(max),
+          mask(1),
+          noHosts(0),
+          seed(s),
+          draws(0),
+          loss(0),
+          minLatency(0),
+          maxLatency(0),
+          order(0)
+    {
+        /* The lookup table is kept at most half full, so probing sequences stay short */
+        while (mask + 1 < 2 * maxHosts)
+            mask = (mask << 1) | 1;
+        slots.reset(new std::atomic<Endpoint*>[mask + 1]);
+        for (size_t i = 0; i <= mask; i++)
+            slots[i] = nullptr;
+        hosts.reset(new std::atomic<Endpoint*>[maxHosts]);
+        for (size_t i = 0; i < maxHosts; i++)
+            hosts[i] = nullptr;
+    }
+
+    std::shared_ptr<Transport> MemoryBus::attach(const std::string &ip) {
+        std::lock_guard<std::mutex> lk(attachMutex);
+        Endpoint *endpoint = find(ip);
+        if (endpoint != nullptr) {
+            endpoint->alive = true;
+            endpoint->closed = false;
+            return std::make_shared<Port>(*this, endpoint);
+        }
+
+        size_t index = noHosts.load();
+        if (index == maxHosts)
+            throw std::runtime_error("MemoryBus: too many hosts attached");
+
+        endpoints.push_back(std::make_unique<Endpoint>());
+        endpoint = endpoints.back().get();
+        endpoint->ip = ip;
+        endpoint->incoming = nullptr;
+        endpoint->nextDelivery = WAKEONLAN_BUS_NO_DELIVERY;
+        endpoint->parked = false;
+        endpoint->alive = true;
+        endpoint->closed = false;
+        endpoint->sent = 0;
+        endpoint->received = 0;
+        endpoint->dropped = 0;
+
+        /* Publishes the endpoint once initialized; readers never see a partially built endpoint */
+        size_t slot = std::hash<std::string>()(ip) & mask;
+        while (slots[slot].load() != nullptr)
+            slot = (slot + 1) & mask;
+        slots[slot] = endpoint;
+        hosts[index] = endpoint;
+        noHosts = index + 1;
+        return std::make_shared<Port>(*this, endpoint);
+    }
+
+    MemoryBus::Endpoint* MemoryBus::find(const std::string &ip) const {
+        size_t slot = std::hash<std::string>()(ip) & mask;
+        Endpoint *endpoint;
+        while ((endpoint = slots[slot].load()) != nullptr) {
+            if (endpoint->ip == ip)
+                return endpoint;
+            slot = (slot + 1) & mask;
+        }
+        return nullptr;
+    }
+
+    void MemoryBus::setLoss(double probability) {
+        loss = std::min(std::max(probability, 0.0), 1.0);
+    }
+
+    void MemoryBus::setLatency(uint32_t minMs, uint32_t maxMs) {
+        minLatency = std::min(minMs, maxMs);
+        maxLatency = std::max(minMs, maxMs);
+    }
+
+    void MemoryBus::kill(const std::string &ip) {
+        Endpoint *endpoint = find(ip);
+        if (endpoint != nullptr)
+            endpoint->alive = false;
+    }
+
+    void MemoryBus::revive(const std::string &ip) {
+        Endpoint *endpoint = find(ip);
+        if (endpoint != nullptr)
+            endpoint->alive = true;
+    }
+
+    MemoryBus::Counters MemoryBus::getCounters(const std::string &ip) {
+        Endpoint *endpoint = find(ip);
+        if (endpoint == nullptr)
+            return Counters{0, 0, 0};
+        return Counters{endpoint->sent, endpoint->received, endpoint->dropped};
+    }
+
+    MemoryBus::Counters MemoryBus::getTotals() {
+        Counters totals{0, 0, 0};
+        size_t count = noHosts.load();
+        for (size_t i = 0; i < count; i++) {
+            totals.sent += hosts[i].load()->sent;
+            totals.received += hosts[i].load()->received;
+            totals.dropped += hosts[i].load()->dropped;
+        }
+        return totals;
+    }
+
+    bool MemoryBus::hasDueMessages() {
+        uint64_t now = clock->now();
+        size_t count = noHosts.load();
+        for (size_t i = 0; i < count; i++) {
+            Endpoint *endpoint = hosts[i].load();
+            if (!endpoint->closed && endpoint->nextDelivery.load() <= now)
+                return true;
+        }
+        return false;
+    }
+
+    void MemoryBus::resetCounters() {
+        size_t count = noHosts.load();
+        for (size_t i = 0; i < count; i++) {
+            hosts[i].load()->sent = 0;
+            hosts[i].load()->received = 0;
+            hosts[i].load()->dropped = 0;
+        }
+    }
+
+    uint64_t MemoryBus::draw() {
+        /* splitmix64 over the draw counter: lock-free, and repeatable for a given seed and send order */
+        uint64_t z = seed + (draws.fetch_add(1) + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    void MemoryBus::deliver(Endpoint &from, Endpoint &to, const Message &message) {
+        from.sent++;
+        double probability = loss.load();
+        if (!from.alive || !to.alive
+            || (probability > 0 && (draw() >> 11) * (1.0 / 9007199254740992.0) < probability)) {
+            from.dropped++;
+            return;
+        }
+        if (to.closed)
+            return;
+
+        uint32_t min = minLatency.load();
+        uint32_t max = maxLatency.load();
+        uint32_t latency = max > min ? min + draw() % (max - min + 1) : min;
+        uint64_t deliverAt = clock->now() + latency;
+
+        auto *node = new Incoming{Delivery{deliverAt, order.fetch_add(1), message}, to.incoming.load()};
+        while (!to.incoming.compare_exchange_weak(node->next, node));
+
+        uint64_t next = to.nextDelivery.load();
+        while (deliverAt < next && !to.nextDelivery.compare_exchange_weak(next, deliverAt));
+
+        if (to.parked) {
+            std::lock_guard<std::mutex> lk(to.mutex);
+            to.cv.notify_all();
+        }
+    }
+
+    MemoryBus::Port::Port(MemoryBus &b, Endpoint *e)
+        : bus(b),
+          endpoint(e)
+    {}
+
+    bool MemoryBus::Port::send(const Message &message, const std::string &ip) {
+        if (ip == WAKEONLAN_BUS_BROADCAST_ADDRESS)
+            return broadcast(message);
+
+        Endpoint *destination = bus.find(ip);
+        if (destination == nullptr) {
+            endpoint->sent++;
+            endpoint->dropped++;
+            return true; // as on UDP, a datagram to an absent host is silently lost
+        }
+        bus.deliver(*endpoint, *destination, message);
+        return true;
+    }
+
+    bool MemoryBus::Port::broadcast(const Message &message) {
+        size_t count = bus.noHosts.load();
+        for (size_t i = 0; i < count; i++)
+            bus.deliver(*endpoint, *bus.hosts[i].load(), message);
+        return true;
+    }
+
+    void MemoryBus::Port::drain() {
+        auto &inbox = endpoint->inbox;
+        do {
+            Incoming *node = endpoint->incoming.exchange(nullptr);
+            while (node != nullptr) {
+                inbox.push(std::move(node->delivery));
+                Incoming *next = node->next;
+                delete node;
+                node = next;
+            }
+            endpoint->nextDelivery = inbox.empty() ? WAKEONLAN_BUS_NO_DELIVERY : inbox.top().deliverAt;
+            /* A message pushed meanwhile may have lowered the earliest delivery time before the store above */
+        } while (endpoint->incoming.load() != nullptr);
+    }
+
+    bool MemoryBus::Port::receive(Message &message, uint32_t timeoutMs) {
+        auto &inbox = endpoint->inbox;
+        uint64_t deadline = bus.clock->now() + timeoutMs;
+        while (!endpoint->closed) {
+            drain();
+            uint64_t now = bus.clock->now();
+            if (!inbox.empty() && inbox.top().deliverAt <= now) {
+                message = inbox.top().message;
+                inbox.pop();
+                endpoint->received++;
+                drain();
+                return true;
+            }
+            if (now >= deadline)
+                return false;
+
+            /* Parks until the next delivery time, or until a sender pushes a message */
+            uint64_t wakeUp = inbox.empty() ? deadline : std::min(deadline, inbox.top().deliverAt);
+            std::unique_lock<std::mutex> lk(endpoint->mutex);
+            endpoint->parked = true;
+            bus.clock->waitUntil(endpoint->cv, lk, wakeUp, [this]() {
+                return endpoint->closed || endpoint->incoming.load() != nullptr;
+            });
+            endpoint->parked = false;
+        }
+        return false;
+    }
+
+    void MemoryBus::Port::close() {
+        endpoint->closed = true;
+        std::lock_guard<std::mutex> lk(endpoint->mutex);
+        endpoint->cv.notify_all();
+    }
+} // namespace WakeOnLanImpl
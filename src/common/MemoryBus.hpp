@@ -0,0 +1,194 @@
+#pragma once
+#include <mutex>
+#include <queue>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <condition_variable>
+#include <../src/common/Clock.hpp>
+#include <../src/common/Transport.hpp>
+
+#define WAKEONLAN_BUS_MAX_HOSTS 65536
+
+namespace WakeOnLanImpl {
+    /**
+     * @class MemoryBus
+     * An in-memory network segment. Every host attached to the bus gets a ::Transport addressed by its IP address,
+     * so many full host stacks can run inside a single process. Delivery follows the bus clock: a message sent with
+     * latency is only received once the clock reaches its delivery time. The bus can drop messages at random,
+     * delay them, and kill hosts (every message sent by or to a killed host is dropped), which makes it suitable
+     * for simulating the protocol on lossy networks and host failures.
+     *
+     * Sending is lock-free, so thousands of hosts can share the bus: hosts are looked up on a fixed-size open
+     * addressing table, and a message is pushed on a lock-free stack of the receiver, which moves it to its own
+     * delivery queue. Senders only take the receiver mutex to wake it up when it is parked waiting for a message.
+     * Attaching a host takes a lock.
+     *
+     * The class is thread-safe.
+     */
+    class MemoryBus {
+    public:
+        /**
+         * @struct Counters
+         * The messages handled by the bus for a host (or for the whole bus).
+         */
+        struct Counters {
+            uint64_t sent;          ///< Messages sent (a broadcast counts once per receiver).
+            uint64_t received;      ///< Messages received.
+            uint64_t dropped;       ///< Messages dropped by the loss, or because the sender or receiver was killed.
+        };
+
+        /**
+         * MemoryBus constructor.
+         * @param clock The clock driving the delivery of the messages.
+         * @param seed The seed of the random drops and latencies, so a simulation can be repeated.
+         * @param maxHosts The maximum number of hosts attached to the bus.
+         */
+        explicit MemoryBus(std::shared_ptr<Clock> clock, uint32_t seed = 1, size_t maxHosts = WAKEONLAN_BUS_MAX_HOSTS);
+
+        /**
+         * Attaches a host to the bus. Attaching an attached host reopens its transport.
+         * @param ip The host IP address.
+         * @returns The transport of the host.
+         */
+        std::shared_ptr<Transport> attach(const std::string &ip);
+
+        /**
+         * Sets the probability of a message being dropped. Default is 0.
+         * @param probability The drop probability, from 0 to 1.
+         * @returns None.
+         */
+        void setLoss(double probability);
+
+        /**
+         * Sets the latency of the messages, drawn uniformly between the bounds. Default is 0.
+         * @param minMs The minimum latency, in milliseconds.
+         * @param maxMs The maximum latency, in milliseconds.
+         * @returns None.
+         */
+        void setLatency(uint32_t minMs, uint32_t maxMs);
+
+        /**
+         * Kills a host: every message sent by or to it is dropped until it is revived.
+         * @param ip The host IP address.
+         * @returns None.
+         */
+        void kill(const std::string &ip);
+
+        /**
+         * Revives a killed host.
+         * @param ip The host IP address.
+         * @returns None.
+         */
+        void revive(const std::string &ip);
+
+        /**
+         * Gets the messages handled for a host.
+         * @param ip The host IP address.
+         * @returns The host counters.
+         */
+        Counters getCounters(const std::string &ip);
+
+        /**
+         * Gets the messages handled by the whole bus.
+         * @returns The bus counters.
+         */
+        Counters getTotals();
+
+        /**
+         * Indicates a message is due on the inbox of a host, waiting to be received. Simulations use it to let the
+         * hosts handle the messages of a step before advancing the clock.
+         * @returns A bool indicating a message is due.
+         */
+        bool hasDueMessages();
+
+        /**
+         * Resets the counters of every host.
+         * @returns None.
+         */
+        void resetCounters();
+    private:
+        /**
+         * @struct Delivery
+         * A message in flight to a host.
+         */
+        struct Delivery {
+            uint64_t deliverAt;     ///< The time (ms) the message is delivered.
+            uint64_t order;         ///< The send order, keeping messages with the same delivery time in order.
+            Message message;        ///< The message.
+
+            bool operator>(const Delivery &other) const {
+                return deliverAt != other.deliverAt ? deliverAt > other.deliverAt : order > other.order;
+            }
+        };
+
+        /**
+         * @struct Incoming
+         * A message pushed by a sender, not yet moved to the receiver inbox.
+         */
+        struct Incoming {
+            Delivery delivery;      ///< The message.
+            Incoming *next;         ///< The message pushed before.
+        };
+
+        /**
+         * @struct Endpoint
+         * A host attached to the bus.
+         */
+        struct Endpoint {
+            ~Endpoint();
+
+            std::string ip;                                     ///< The host IP address.
+            std::atomic<Incoming*> incoming;                    ///< The messages pushed by the senders.
+            std::priority_queue<Delivery, std::vector<Delivery>, std::greater<Delivery>> inbox; ///< The messages in flight (receiver only).
+            std::atomic<uint64_t> nextDelivery;                 ///< The earliest delivery time (UINT64_MAX when empty).
+            std::mutex mutex;                                   ///< The mutex the receiver parks on.
+            std::condition_variable cv;                         ///< Notified when a message arrives for a parked receiver.
+            std::atomic<bool> parked;                           ///< Indicates the receiver waits for a message.
+            std::atomic<bool> alive;                            ///< Indicates the host was not killed.
+            std::atomic<bool> closed;                           ///< Indicates the host transport was closed.
+            std::atomic<uint64_t> sent;                         ///< Messages sent by the host.
+            std::atomic<uint64_t> received;                     ///< Messages received by the host.
+            std::atomic<uint64_t> dropped;                      ///< Messages sent by or to the host and dropped.
+        };
+
+        /**
+         * @class Port
+         * The transport of a host attached to the bus.
+         */
+        class Port : public Transport {
+        public:
+            Port(MemoryBus &bus, Endpoint *endpoint);
+
+            bool send(const Message &message, const std::string &ip) override;
+            bool broadcast(const Message &message) override;
+            bool receive(Message &message, uint32_t timeoutMs) override;
+            void close() override;
+        private:
+            void drain();
+
+            MemoryBus &bus;             ///< The bus the host is attached to.
+            Endpoint *endpoint;         ///< The host endpoint.
+        };
+
+        Endpoint* find(const std::string &ip) const;
+        void deliver(Endpoint &from, Endpoint &to, const Message &message);
+        uint64_t draw();
+
+        std::shared_ptr<Clock> clock;                       ///< The clock driving the deliveries.
+        size_t maxHosts;                                    ///< The maximum number of hosts.
+        size_t mask;                                        ///< The mask of the lookup table (its size minus one).
+        std::unique_ptr<std::atomic<Endpoint*>[]> slots;    ///< The lookup table, by IP address hash.
+        std::unique_ptr<std::atomic<Endpoint*>[]> hosts;    ///< The attached hosts, in attach order.
+        std::atomic<size_t> noHosts;                        ///< The number of attached hosts.
+        std::mutex attachMutex;                             ///< The mutex serializing the attaches.
+        std::vector<std::unique_ptr<Endpoint>> endpoints;   ///< The endpoints owned by the bus.
+        uint64_t seed;                                      ///< The seed of the drops and latencies.
+        std::atomic<uint64_t> draws;                        ///< The random numbers drawn.
+        std::atomic<double> loss;                           ///< The drop probability.
+        std::atomic<uint32_t> minLatency;                   ///< The minimum latency (ms).
+        std::atomic<uint32_t> maxLatency;                   ///< The maximum latency (ms).
+        std::atomic<uint64_t> order;                        ///< The number of messages sent.
+    };
+} // namespace WakeOnLanImpl
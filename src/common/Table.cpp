@@ -1,126 +1,375 @@
-#include <condition_variable>
 #include <iostream>
+#include <algorithm>
 #include <../src/common/Table.hpp>
+#include <../src/common/TableStore.hpp>
 
 namespace WakeOnLanImpl {
-    bool updated = false;
-    std::condition_variable cv;
+#define WAKEONLAN_TABLE_FEED_SIZE 4096
+
+    /**
+     * Records a mutation on the persistence layer, if enabled. Returns true when the write-ahead log must be compacted.
+     */
+    static bool persist(std::mutex &storeMutex,
+                        std::unique_ptr<TableStore> &store,
+                        TableStore::Operation op,
+                        uint32_t seq,
+                        const Table::Participant &participant) {
+        std::lock_guard<std::mutex> lk(storeMutex);
+        if (!store)
+            return false;
+        store->append(op, seq, participant);
+        return store->needsCompaction();
+    }
+
+    /**
+     * Gets the digest of a row, over every field sent on the table updates. The table digest is the sum of the
+     * digests of its rows, so it does not depend on the row order and is updated in place as rows change.
+     */
+    static uint64_t digestOf(const Table::Participant &participant) {
+        uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+        for (auto *field : {&participant.electedTimestamp, &participant.hostname, &participant.ip, &participant.mac}) {
+            for (unsigned char c : *field)
+                hash = (hash ^ c) * 0x100000001b3ULL;
+            hash = (hash ^ 0xff) * 0x100000001b3ULL; // field separator
+        }
+        hash = (hash ^ static_cast<uint8_t>(participant.status)) * 0x100000001b3ULL;
+        return hash;
+    }
+
+    Table::Table(size_t noShards)
+        : seq(0),
+          rowsDigest(0),
+          compactionPending(false),
+          version(0),
+          trimmedVersion(0),
+          stale(false)
+    {
+        log = spdlog::get("wakeonlan-api");
+        shards.reserve(std::max<size_t>(noShards, 1));
+        for (size_t i = 0; i < std::max<size_t>(noShards, 1); i++)
+            shards.push_back(std::make_unique<Shard>());
+    }
+
+    Table::~Table() {}
 
     Table &Table::get() {
         static Table instance;
         return instance;
     }
 
-    std::pair<uint32_t, std::vector<Table::Participant>> Table::insert(const Participant &participant) {
-        bool opSucceded = false;
-        uint32_t updateSeqNo = 0;
-        std::lock_guard<std::mutex> lk(tableMutex);
-        opSucceded = data.insert(std::make_pair(participant.hostname, participant)).second;
-        if (opSucceded) {
-            if (data.size() == 2)
-                seq = 1;
-            else if (data.size() > 2)
-                seq++;
-            updateSeqNo = seq;
-            updated = true;
-            cv.notify_one();
-        }
-        std::vector<Table::Participant> members;
-        members.reserve(data.size());
-        for(auto& entry: data)
-            members.push_back(entry.second);
-        return std::make_pair(updateSeqNo, members);
+    Table::Shard &Table::shardOf(const std::string &hostname) {
+        return *shards[std::hash<std::string>()(hostname) % shards.size()];
     }
 
-    bool Table::transaction(const uint32_t & seqNo, const std::vector<Participant> & tbl) {
-        bool returnCode = false;
-        std::lock_guard<std::mutex> lk(tableMutex);
+    std::vector<std::unique_lock<std::mutex>> Table::lockAll() {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards.size());
+        for (auto &shard : shards)
+            locks.emplace_back(shard->mutex);
+        return locks;
+    }
+
+    std::vector<Table::Participant> Table::collect() {
+        size_t size = 0;
+        for (auto &shard : shards)
+            size += shard->data.size();
+
+        std::vector<Table::Participant> participants;
+        participants.reserve(size);
+        for (auto &shard : shards)
+            for (auto &entry : shard->data)
+                participants.push_back(entry.second);
+        return participants;
+    }
 
-        data.clear();
-        for (const auto& member : tbl) {
-            returnCode = data.insert(std::make_pair(member.hostname, member)).second;
-            if (!returnCode) {
-                log->error("Error on processing transaction {}", seqNo);
+    bool Table::apply(const Mutation &mutation, Change &change) {
+        auto &shard = shardOf(mutation.participant.hostname);
+        switch (mutation.type) {
+            case MutationType::Insert:
+                if (!shard.data.insert(std::make_pair(mutation.participant.hostname, mutation.participant)).second)
+                    return false;
+                rowsDigest += digestOf(mutation.participant);
+                change.type = ChangeType::Inserted;
+                change.participant = mutation.participant;
+                return true;
+            case MutationType::Update:
+            {
+                auto it = shard.data.find(mutation.participant.hostname);
+                if (it == shard.data.end())
+                    return false;
+
+                uint64_t previous = digestOf(it->second);
+                auto status = mutation.participant.status;
+                if(it->second.status != status && status != ParticipantStatus::Manager)
+                {
+                    it->second.status = status;
+                }
+                else if(status == ParticipantStatus::Manager)
+                {
+                    it->second.status = status;
+                    auto mt  = std::chrono::system_clock::now();
+                    ::time_t t = std::chrono::system_clock::to_time_t(mt);
+                    struct tm * ti = ::gmtime(&t);
+                    char buffer[80];
+                    ::strftime(buffer, 80, "%d-%m-%Y %H:%M:%S", ti);
+                    it->second.electedTimestamp = buffer;
+                }
+                else {
+                    /* The participant already has the status */
+                    return false;
+                }
+                rowsDigest += digestOf(it->second) - previous;
+                change.type = ChangeType::Updated;
+                change.participant = it->second;
+                return true;
             }
+            case MutationType::Remove:
+            {
+                auto it = shard.data.find(mutation.participant.hostname);
+                if (it == shard.data.end())
+                    return false;
+                rowsDigest -= digestOf(it->second);
+                shard.data.erase(it);
+                change.type = ChangeType::Removed;
+                change.participant = Participant();
+                change.participant.hostname = mutation.participant.hostname;
+                change.participant.status = ParticipantStatus::Unknown;
+                return true;
+            }
+            default:
+                return false;
         }
-        seq = seqNo;
+    }
 
-        if (returnCode) {
-            updated = true;
-            cv.notify_one();
+    /**
+     * Gets the persistence operation recording a change.
+     */
+    static TableStore::Operation operationOf(Table::ChangeType type) {
+        switch (type) {
+            case Table::ChangeType::Inserted:
+                return TableStore::Operation::Insert;
+            case Table::ChangeType::Removed:
+                return TableStore::Operation::Remove;
+            default:
+                return TableStore::Operation::Update;
         }
+    }
 
-        return returnCode;
+    uint32_t Table::insert(const Participant &participant) {
+        return applyOne(Mutation{MutationType::Insert, participant});
     }
 
-    std::pair<uint32_t, std::vector<Table::Participant>> Table::update(const ParticipantStatus &status, const std::string &hostname) {
-        uint32_t updateSeqNo = 0;
-        std::lock_guard<std::mutex> lk(tableMutex);
-        auto it = data.find(hostname);
-        if (it != data.end()) {
-            if(it->second.status != status && status != ParticipantStatus::Manager)
-            {
-                it->second.status = status;
-                updated = true;
-                cv.notify_one();
-                seq++;
-                updateSeqNo = seq;
+    bool Table::transaction(const uint32_t & seqNo, const std::vector<Participant> & tbl, bool force) {
+        bool compact = false;
+        {
+            auto locks = lockAll();
+            if (!force && !stale && seqNo <= seq) {
+                if (log)
+                    log->info("Rejected transaction {}, table is at {}", seqNo, seq.load());
+                return false;
             }
-            if(status == ParticipantStatus::Manager)
-            {
-                it->second.status = status;
-                auto mt  = std::chrono::system_clock::now();
-                ::time_t t = std::chrono::system_clock::to_time_t(mt);
-                struct tm * ti = ::gmtime(&t);
-                char buffer[80];
-                ::strftime(buffer, 80, "%d-%m-%Y %H:%M:%S", ti);
-                it->second.electedTimestamp = buffer;
-                updated = true;
-                cv.notify_one();
-                seq++;
-                updateSeqNo = seq;
+
+            /* Only the rows that differ from the current ones are changed */
+            std::vector<Change> changes;
+            std::unordered_map<std::string, const Participant*> rows;
+            rows.reserve(tbl.size());
+            for (const auto &member : tbl) {
+                if (!rows.emplace(member.hostname, &member).second) {
+                    if (log)
+                        log->error("Error on processing transaction {}: duplicated member {}", seqNo, member.hostname);
+                    continue;
+                }
+                auto &data = shardOf(member.hostname).data;
+                auto it = data.find(member.hostname);
+                if (it == data.end()) {
+                    data.emplace(member.hostname, member);
+                    rowsDigest += digestOf(member);
+                    changes.push_back(Change{0, ChangeType::Inserted, member});
+                    compact |= persist(storeMutex, store, TableStore::Operation::Insert, seqNo, member);
+                }
+                else if (it->second.status != member.status || it->second.ip != member.ip
+                         || it->second.mac != member.mac || it->second.electedTimestamp != member.electedTimestamp) {
+                    rowsDigest += digestOf(member) - digestOf(it->second);
+                    it->second = member;
+                    changes.push_back(Change{0, ChangeType::Updated, member});
+                    compact |= persist(storeMutex, store, TableStore::Operation::Update, seqNo, member);
+                }
+            }
+            for (auto &shard : shards) {
+                for (auto it = shard->data.begin(); it != shard->data.end();) {
+                    if (rows.count(it->first)) {
+                        ++it;
+                        continue;
+                    }
+                    Participant removed;
+                    removed.hostname = it->first;
+                    removed.status = ParticipantStatus::Unknown;
+                    rowsDigest -= digestOf(it->second);
+                    changes.push_back(Change{0, ChangeType::Removed, removed});
+                    compact |= persist(storeMutex, store, TableStore::Operation::Remove, seqNo, removed);
+                    it = shard->data.erase(it);
+                }
             }
+
+            seq = seqNo;
+            bool confirmed = stale.exchange(false); // the manager sent it
+            if (!changes.empty() || confirmed)
+                publish(changes);
+        }
+        if (compact) {
+            compactionPending = true;
+            compactStore();
         }
+
+        return true;
+    }
+
+    uint32_t Table::update(const ParticipantStatus &status, const std::string &hostname) {
+        Mutation mutation{MutationType::Update, Participant()};
+        mutation.participant.hostname = hostname;
+        mutation.participant.status = status;
+        return applyOne(mutation);
+    }
+
+    uint32_t Table::remove(const std::string &hostname) {
+        Mutation mutation{MutationType::Remove, Participant()};
+        mutation.participant.hostname = hostname;
+        mutation.participant.status = ParticipantStatus::Unknown;
+        return applyOne(mutation);
+    }
+
+    uint32_t Table::applyOne(const Mutation &mutation, std::vector<Change> *changes) {
+        std::vector<Change> applied;
+        bool compact = false;
+        uint32_t seqNo = 0;
+        {
+            /* A single mutation only locks the shard of its row */
+            std::lock_guard<std::mutex> lk(shardOf(mutation.participant.hostname).mutex);
+            Change change{0, ChangeType::Inserted, Participant()};
+            if (!apply(mutation, change))
+                return 0;
+
+            seqNo = ++seq;
+            applied.push_back(change);
+            publish(applied);
+            compact = persist(storeMutex, store, operationOf(change.type), seqNo, change.participant);
+        }
+        if (changes)
+            *changes = applied;
+        if (compact) {
+            compactionPending = true;
+            compactStore();
+        }
+        return seqNo;
+    }
+
+    std::pair<uint32_t, std::vector<Table::Participant>> Table::applyBatch(const std::vector<Mutation> &batch,
+                                                                          std::vector<Change> *changes) {
+        std::vector<Change> applied;
+        bool compact = false;
+        uint32_t seqNo = 0;
+
+        /* The callers multicast the table, which is copied after the shard lock is released */
+        if (batch.size() == 1) {
+            if (!applyOne(batch.front(), changes))
+                return std::make_pair(0, std::vector<Table::Participant>());
+            return snapshot();
+        }
+
         std::vector<Table::Participant> members;
-        members.reserve(data.size());
-        for(auto& entry: data)
-            members.push_back(entry.second);
-        return std::make_pair(updateSeqNo, members);
-    }
-
-    std::pair<uint32_t, std::vector<Table::Participant>> Table::remove(const std::string &hostname) {
-        uint32_t updateSeqNo = 0;
-        std::lock_guard<std::mutex> lk(tableMutex);
-        if (data.count(hostname))
-            if (data.erase(hostname)) {
-                updated = true;
-                seq++;
-                updateSeqNo = seq;
-                cv.notify_one();
+        {
+            auto locks = lockAll();
+            for (auto &mutation : batch) {
+                Change change{0, ChangeType::Inserted, Participant()};
+                if (apply(mutation, change))
+                    applied.push_back(change);
             }
-        std::vector<Table::Participant> members;
-        members.reserve(data.size());
-        for(auto& entry: data)
-            members.push_back(entry.second);
-        return std::make_pair(updateSeqNo, members);
+            if (applied.empty())
+                return std::make_pair(0, std::vector<Table::Participant>());
+
+            seqNo = ++seq;
+            for (auto &change : applied)
+                compact |= persist(storeMutex, store, operationOf(change.type), seqNo, change.participant);
+            publish(applied);
+            members = collect();
+        }
+        if (changes)
+            *changes = applied;
+        if (compact) {
+            compactionPending = true;
+            compactStore();
+        }
+        return std::make_pair(seqNo, members);
     }
-    
-    std::vector<Table::Participant> Table::get_participants_interface() {
-        std::vector<Table::Participant> participants;
-        std::unique_lock<std::mutex> lk(tableMutex);
-        while (!updated) cv.wait(lk);
-        for(auto& entry: data)
-            participants.push_back(entry.second);
-        updated = false;
-        return participants;
+
+    Table::ChangeSet Table::waitForChanges(uint64_t after, std::chrono::milliseconds timeout) {
+        ChangeSet changeSet;
+        std::unique_lock<std::mutex> lk(feedMutex);
+        if (after <= version)
+            feedCv.wait_for(lk, timeout, [this, after]() { return version > after; });
+
+        changeSet.version = version;
+        changeSet.reset = false;
+        changeSet.stale = stale;
+        if (after == version)
+            return changeSet;
+
+        /* The subscriber is ahead of the feed or the changes after its version were trimmed */
+        if (after > version || after < trimmedVersion) {
+            lk.unlock();
+            auto locks = lockAll();
+            lk.lock();
+            changeSet.version = version;
+            changeSet.reset = true;
+            for (auto &participant : collect())
+                changeSet.changes.push_back(Change{version, ChangeType::Inserted, participant});
+            return changeSet;
+        }
+
+        auto it = std::upper_bound(feed.begin(), feed.end(), after,
+                                   [](uint64_t v, const Change &change) { return v < change.version; });
+        for (; it != feed.end(); ++it) {
+            if (it->type == ChangeType::Reset) {
+                changeSet.reset = true;
+                changeSet.changes.clear();
+                continue;
+            }
+            changeSet.changes.push_back(*it);
+        }
+        return changeSet;
+    }
+
+    void Table::publish(std::vector<Change> changes) {
+        std::lock_guard<std::mutex> lk(feedMutex);
+        version++;
+        for (auto &change : changes) {
+            change.version = version;
+            feed.push_back(std::move(change));
+        }
+        while (feed.size() > WAKEONLAN_TABLE_FEED_SIZE) {
+            trimmedVersion = feed.front().version;
+            feed.pop_front();
+        }
+        feedCv.notify_all();
     }
 
     std::vector<Table::Participant> Table::get_participants_monitoring() {
-        std::vector<Table::Participant> participants;
-        std::unique_lock<std::mutex> lk(tableMutex);
-        for(auto& entry: data)
-            participants.push_back(entry.second);
-        return participants;
+        return snapshot().second;
+    }
+
+    std::pair<uint32_t, std::vector<Table::Participant>> Table::snapshot() {
+        auto locks = lockAll();
+        return std::make_pair(seq.load(), collect());
+    }
+
+    uint32_t Table::sequence() const {
+        return seq.load();
+    }
+
+    std::pair<uint32_t, uint64_t> Table::digest() {
+        /* Mutations update the sequence number and the digest with their shard locked */
+        auto locks = lockAll();
+        return std::make_pair(seq.load(), rowsDigest.load());
     }
 
     Table::Participant Table::get_manager()
@@ -128,16 +377,69 @@ namespace WakeOnLanImpl {
         Participant empty_participant;
         empty_participant.status = ParticipantStatus::Unknown;
 
-        if (data.empty())
-            return empty_participant;
+        for (auto &shard : shards) {
+            std::lock_guard<std::mutex> lk(shard->mutex);
+            for(auto& entry: shard->data)
+                if(entry.second.status == ParticipantStatus::Manager)
+                    return entry.second;
+        }
 
-        std::unique_lock<std::mutex> lk(tableMutex);
-        for(auto& entry: data)
-            if(entry.second.status == ParticipantStatus::Manager)
-                return entry.second;
-        
         // if couldn't find manager
         return empty_participant;
     }
 
+    void Table::compactStore() {
+        if (!compactionPending.exchange(false))
+            return;
+
+        auto locks = lockAll();
+        std::unordered_map<std::string, Participant> data;
+        for (auto &shard : shards)
+            data.insert(shard->data.begin(), shard->data.end());
+
+        std::lock_guard<std::mutex> lk(storeMutex);
+        if (store)
+            store->compact(seq, data);
+    }
+
+    size_t Table::enablePersistence(const std::string &directory) {
+        auto locks = lockAll();
+        std::lock_guard<std::mutex> lk(storeMutex);
+        std::unordered_map<std::string, Participant> data;
+        uint32_t seqNo = 0;
+
+        store = std::make_unique<TableStore>(directory);
+        if (!store->load(data, seqNo)) {
+            if (log)
+                log->error("Failed to enable table persistence on {}", directory);
+            store.reset();
+            return 0;
+        }
+        if (log)
+            log->info("Table persistence enabled on {} [seq={} no_entries={}]", directory, seqNo, data.size());
+
+        std::vector<Change> changes;
+        changes.reserve(data.size() + 1);
+        changes.push_back(Change{0, ChangeType::Reset, Participant()});
+        for (auto &shard : shards)
+            shard->data.clear();
+        rowsDigest = 0;
+        for (auto &entry : data) {
+            shardOf(entry.first).data.insert(entry);
+            rowsDigest += digestOf(entry.second);
+            changes.push_back(Change{0, ChangeType::Inserted, entry.second});
+        }
+        seq = seqNo;
+        publish(changes);
+        return data.size();
+    }
+
+    void Table::setStale(bool value) {
+        if (stale.exchange(value) != value)
+            publish({});
+    }
+
+    bool Table::isStale() const {
+        return stale.load();
+    }
 } // namespace WakeOnLanImpl
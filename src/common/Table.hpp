@@ -1,17 +1,30 @@
 #pragma once
 #include <mutex>
+#include <atomic>
+#include <deque>
+#include <chrono>
 #include <string>
 #include <memory>
+#include <vector>
 #include <unordered_map>
+#include <condition_variable>
 #include <spdlog/spdlog.h>
 
 namespace WakeOnLanImpl {
+#define WAKEONLAN_TABLE_SHARDS 16
+
+    class TableStore;
+
     /**
      * @class Table
      * This class is the generic representation of a group of participants. Every ::Participant being part of a
      * table represents a host on the local network that is subscribed and connected to the service managed by an
      * instance of the API running a manager handler. Operations over the table are realized by the services supported
      * by the ::ManagerHandler struct.
+     *
+     * Rows are spread over shards by the hash of the hostname, each shard guarded by its own lock, so operations
+     * over different participants do not contend. The sequence number is a global atomic counter and operations
+     * spanning the whole table (snapshots, transactions) lock every shard in order.
      */
     class Table {
     public:
@@ -43,6 +56,58 @@ namespace WakeOnLanImpl {
             ParticipantStatus status;   ///< The participant status.
         };
 
+        /**
+         * @enum ChangeType
+         * The kind of change recorded on the table change feed.
+         */
+        enum class ChangeType {
+            Inserted = 0,   ///< The participant was inserted on the table.
+            Updated = 1,    ///< The participant row was updated.
+            Removed = 2,    ///< The participant was removed from the table.
+            Reset = 3       ///< The whole table was replaced. Rows of the new table follow as Inserted changes.
+        };
+
+        /**
+         * @struct Change
+         * A change recorded on the table change feed. Every mutation of the table advances the feed
+         * version once, so all the rows changed by the same mutation share the same version.
+         */
+        struct Change {
+            uint64_t version;           ///< The feed version the change belongs to.
+            ChangeType type;            ///< The kind of change.
+            Participant participant;    ///< The changed row (only the hostname is meaningful for Removed).
+        };
+
+        /**
+         * @enum MutationType
+         * The kind of mutation applied by ::Table::applyBatch().
+         */
+        enum class MutationType {
+            Insert = 0,     ///< Inserts the participant (same as ::Table::insert()).
+            Update = 1,     ///< Updates the status of the participant to the status of the row (same as ::Table::update()).
+            Remove = 2      ///< Removes the participant with the hostname of the row (same as ::Table::remove()).
+        };
+
+        /**
+         * @struct Mutation
+         * A mutation applied by ::Table::applyBatch().
+         */
+        struct Mutation {
+            MutationType type;          ///< The kind of mutation.
+            Participant participant;    ///< The row to insert, or the hostname (and status) of the row to update or remove.
+        };
+
+        /**
+         * @struct ChangeSet
+         * The changes returned to a subscriber of the table change feed.
+         */
+        struct ChangeSet {
+            uint64_t version;               ///< The feed version the subscriber is synchronized to after applying the changes.
+            bool reset;                     ///< Indicates the subscriber must drop its view before applying the changes.
+            bool stale;                     ///< Indicates the table is a cached copy not confirmed by the manager yet.
+            std::vector<Change> changes;    ///< The changes, in the order they were applied to the table.
+        };
+
         /**
        * Gets a reference of ::Table. ::Table is a singleton class, so then
        * every call to the method will returns a reference to the same object.
@@ -51,43 +116,80 @@ namespace WakeOnLanImpl {
        */
         static Table &get();
 
+        /**
+         * Table constructor. Used to create tables apart from the singleton instance (e.g. on benchmarks).
+         * @param noShards The number of shards. A single shard serializes every operation on one lock.
+         */
+        explicit Table(size_t noShards = WAKEONLAN_TABLE_SHARDS);
+
+        /**
+         * Table destructor.
+         */
+        ~Table();
+
         /**
         * Inserts a previously created Participant. Is assumed the fields of the Participant
         * instance being passed as argument was well set to the right values before call it.
         * The function does not check any field before try to insert in on the data structure
-        * representing the table. The true value is returned to the caller when the participant
-        * was successfully inserted on the table. Otherwise, the false value is returned.
+        * representing the table. Only the shard of the participant is locked and the table is not copied;
+        * callers synchronizing the group take a ::Table::snapshot() when the insertion succeeded.
         *
         * @param participant A Participant reference representing the participant that must be inserted on the table.
-        * @returns A bool indicating the insertion on the participant on the table was successful.
+        * @returns The new sequence number, or 0 when the participant was not inserted.
         */
-        std::pair<uint32_t, std::vector<Participant>> insert(const Participant &participant);
+        uint32_t insert(const Participant &participant);
 
-        bool transaction(const uint32_t & seqNo, const std::vector<Participant> & tbl);
+        /**
+        * Replaces the table by the table sent by the manager on a table update. Updates older than or equal to
+        * the table sequence number are rejected without looking at their rows, so duplicated or reordered updates
+        * neither cost a table rebuild nor roll the table back, unless the caller forces them (e.g. the first
+        * update of a new manager, whose sequence numbers are not comparable) or the table is stale. The rows are
+        * compared with the current ones and only the rows that differ are inserted, updated or removed, so the
+        * change feed and the persistence layer only record the actual changes.
+        *
+        * @param seqNo The sequence number of the update.
+        * @param tbl The rows of the manager table.
+        * @param force A bool indicating the update is applied whatever its sequence number.
+        * @returns A bool indicating the update was applied.
+        */
+        bool transaction(const uint32_t & seqNo, const std::vector<Participant> & tbl, bool force = false);
 
         /**
         * Updates the status of a participant of the table. The function checks if the
         * participant is in fact being part of the group. In case of that, the new
-        * status is assigned to the participant status and the true value is returned to the
-        * caller of the function. Otherwise, false is returned, indicating the update
+        * status is assigned to the participant status and the new sequence number is returned to the
+        * caller of the function. Otherwise, 0 is returned, indicating the update
         * did not occur with success.
         *
         * @param status A reference to an ParticipantStatus type to assigned to the participant
         * @param hostname A string reference.
-        * @returns A bool indicating the update on the participant status was successful
+        * @returns The new sequence number, or 0 when the participant status did not change.
         */
-        std::pair<uint32_t, std::vector<Table::Participant>> update(const ParticipantStatus &status, const std::string &hostname);
+        uint32_t update(const ParticipantStatus &status, const std::string &hostname);
 
         /**
         * Removes of the table a previously inserted Participant. The function checks if the
         * participant is in fact being part of the group. In case of that, the participant is removed
-        * of the group and the true value is returned to the caller of the function. Otherwise,
-        * false is returned, indicating the deletion did not occur with success.
+        * of the group and the new sequence number is returned to the caller of the function. Otherwise,
+        * 0 is returned, indicating the deletion did not occur with success.
         *
         * @param hostname The hostname of the participant to be removed.
-        * @return A bool indicating the participant was deleted of the table with success.
+        * @return The new sequence number, or 0 when the participant was not in the table.
+        */
+        uint32_t remove(const std::string &hostname);
+
+        /**
+        * Applies many inserts, updates and removes atomically. The table is locked once for the whole batch,
+        * the sequence number is advanced once and a single set of changes is published on the change feed,
+        * so the caller synchronizes the group once for the batch instead of once for each mutation.
+        * Mutations follow the rules of the single operations; the ones that do not change the table are skipped.
+        *
+        * @param batch The mutations, applied in order.
+        * @param changes An optional vector receiving the changes actually applied.
+        * @return A pair with the new sequence number (0 when nothing changed) and the table after the batch.
         */
-        std::pair<uint32_t, std::vector<Table::Participant>> remove(const std::string &hostname);
+        std::pair<uint32_t, std::vector<Table::Participant>> applyBatch(const std::vector<Mutation> &batch,
+                                                                       std::vector<Change> *changes = nullptr);
 
         /**
          * Gets all participants registered in the table.
@@ -97,13 +199,41 @@ namespace WakeOnLanImpl {
         std::vector<Participant> get_participants_monitoring();
 
         /**
-         * Gets all participants registered in the table.
-         * The function is operates on a blocking mode. That means
-         * once the function is called, it only returns the control
-         * to the caller after the table is updated by an event.
-         * @return A vector of registered participants.
+         * Gets a consistent copy of the table together with its sequence number. Every shard is
+         * locked while the copy is taken, so the copy reflects a single point of the table history.
+         *
+         * @return A pair containing the table sequence number and the registered participants.
          */
-        std::vector<Participant> get_participants_interface();
+        std::pair<uint32_t, std::vector<Participant>> snapshot();
+
+        /**
+         * Gets the table sequence number.
+         *
+         * @return The sequence number of the last mutation applied to the table.
+         */
+        uint32_t sequence() const;
+
+        /**
+         * Gets a 64-bit digest of the table rows together with the table sequence number. Two tables holding the
+         * same rows have the same digest, whatever the order the rows were inserted in. The digest is kept up to
+         * date by every mutation, so getting it does not go over the rows.
+         *
+         * @return A pair containing the table sequence number and the digest of the rows.
+         */
+        std::pair<uint32_t, uint64_t> digest();
+
+        /**
+         * Waits for changes on the table after a given feed version. Any number of subscribers can wait
+         * concurrently; each one keeps its own version and only receives the rows changed since it. When the
+         * changes requested are no longer retained by the feed, the ChangeSet is marked as reset and carries
+         * the whole table as Inserted changes. The function returns an empty ChangeSet with the same version
+         * when the timeout expires without changes.
+         *
+         * @param version The last feed version seen by the subscriber (0 for a new subscriber).
+         * @param timeout The maximum time to wait for changes.
+         * @return The ChangeSet containing the changes after the version.
+         */
+        ChangeSet waitForChanges(uint64_t version, std::chrono::milliseconds timeout);
 
         /**
          * Gets the current manager as in the last update of the present table.
@@ -111,18 +241,101 @@ namespace WakeOnLanImpl {
          * an empty Participant if otherwise.
          */
         Participant get_manager();
-    private:
-        Table() = default;
 
-        ~Table() = default;
+        /**
+         * Enables the persistence of the table on the directory passed as argument. The rows previously
+         * persisted on the directory are loaded, replacing the current content of the table, and every
+         * following mutation is recorded on the write-ahead log of the ::TableStore.
+         *
+         * @param directory The directory holding the table snapshot and write-ahead log.
+         * @return The number of rows recovered from the directory.
+         */
+        size_t enablePersistence(const std::string &directory);
+
+        /**
+         * Marks the table as stale (a cached copy not confirmed by the manager yet) or confirmed. A participant
+         * restarted with a persisted table shows it right away as stale; the table is confirmed by the next
+         * ::transaction() received from the manager. Change feed subscribers are woken up when the flag changes.
+         *
+         * @param stale A bool indicating the table is stale.
+         */
+        void setStale(bool stale);
 
+        /**
+         * Indicates the table is a cached copy not confirmed by the manager yet.
+         *
+         * @return A bool indicating the table is stale.
+         */
+        bool isStale() const;
+    private:
         Table(const Table &table);
 
         const Table &operator =(const Table &table);
 
-        std::mutex tableMutex;                              ///< The mutex to manage access to the table representation.
+        /**
+         * @struct Shard
+         * A partition of the table rows guarded by its own lock.
+         */
+        struct Shard {
+            std::mutex mutex;                                   ///< The mutex to manage access to the shard rows.
+            std::unordered_map<std::string, Participant> data;  ///< The shard rows.
+        };
+
+        /**
+         * Gets the shard holding a hostname.
+         */
+        Shard &shardOf(const std::string &hostname);
+
+        /**
+         * Applies a mutation on the shard of its row. Must be called with the shard locked.
+         * @param mutation The mutation.
+         * @param change The change receiving the resulting row.
+         * @return A bool indicating the mutation changed the table.
+         */
+        bool apply(const Mutation &mutation, Change &change);
+
+        /**
+         * Applies a single mutation locking only the shard of its row, then publishes and persists it.
+         * @param mutation The mutation.
+         * @param changes An optional vector receiving the change, if applied.
+         * @return The new sequence number, or 0 when the mutation did not change the table.
+         */
+        uint32_t applyOne(const Mutation &mutation, std::vector<Change> *changes = nullptr);
+
+        /**
+         * Locks every shard, in order.
+         */
+        std::vector<std::unique_lock<std::mutex>> lockAll();
+
+        /**
+         * Copies the rows of every shard. Must be called with every shard locked.
+         */
+        std::vector<Participant> collect();
+
+        /**
+         * Records a set of changes on the change feed under a new feed version. Must be called
+         * with the shards of the changed rows locked, so changes of the same row keep their order.
+         */
+        void publish(std::vector<Change> changes);
+
+        /**
+         * Compacts the persistence layer when requested by a previous mutation. Must be called
+         * without any shard locked.
+         */
+        void compactStore();
+
+        std::vector<std::unique_ptr<Shard>> shards;         ///< The table representation.
         std::shared_ptr<spdlog::logger> log;                ///< The Table logger.
-        std::unordered_map<std::string, Participant> data;  ///< The table representation.
-        uint32_t seq;
+        std::atomic<uint32_t> seq;                          ///< The table sequence number.
+        std::atomic<uint64_t> rowsDigest;                   ///< The sum of the digests of the rows.
+        std::mutex storeMutex;                              ///< The mutex to manage access to the persistence layer.
+        std::unique_ptr<TableStore> store;                  ///< The optional persistence layer.
+        std::atomic<bool> compactionPending;                ///< Indicates the persistence layer must be compacted.
+        std::mutex feedMutex;                               ///< The mutex to manage access to the change feed.
+        std::condition_variable feedCv;                     ///< Notifies the change feed subscribers.
+        std::deque<Change> feed;                            ///< The most recent changes applied to the table.
+        uint64_t version;                                   ///< The current change feed version.
+        uint64_t trimmedVersion;                            ///< The newest feed version with changes no longer retained.
+        std::atomic<bool> stale;                            ///< Indicates the table was not confirmed by the manager yet.
     };
 } // namespace WakeOnLanImpl
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include <../src/common/TableStore.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace WakeOnLanImpl {
+#define WAKEONLAN_STORE_VERSION 1
+#define WAKEONLAN_STORE_SNAPSHOT_MAGIC "WOLS"
+#define WAKEONLAN_STORE_LOG_MAGIC "WOLL"
+#define WAKEONLAN_STORE_SNAPSHOT_FILE "/table.snapshot"
+#define WAKEONLAN_STORE_LOG_FILE "/table.wal"
+#define WAKEONLAN_STORE_COMPACTION_THRESHOLD 1024
+
+    TableStore::TableStore(const std::string &directory)
+        : directory(directory),
+          snapshotPath(directory + WAKEONLAN_STORE_SNAPSHOT_FILE),
+          logPath(directory + WAKEONLAN_STORE_LOG_FILE),
+          logFd(-1),
+          generation(0),
+          records(0)
+    {
+        log = spdlog::get("wakeonlan-api");
+    }
+
+    TableStore::~TableStore() {
+        if (logFd >= 0)
+            close(logFd);
+    }
+
+    /**
+     * Copies a string on a fixed-size record field, truncated to the field size and zero-filled after it.
+     */
+    template <size_t N>
+    static void copyField(char (&field)[N], const std::string &value) {
+        size_t length = std::min(value.size(), N);
+        memcpy(field, value.data(), length);
+        memset(field + length, 0, N - length);
+    }
+
+    void TableStore::encode(const Table::Participant &participant, StoredParticipant &entry) {
+        memset(&entry, 0, sizeof(entry));
+        copyField(entry.electedTimestamp, participant.electedTimestamp);
+        copyField(entry.hostname, participant.hostname);
+        copyField(entry.ip, participant.ip);
+        copyField(entry.mac, participant.mac);
+        entry.status = static_cast<uint8_t>(participant.status);
+    }
+
+    Table::Participant TableStore::decode(const StoredParticipant &entry) {
+        Table::Participant participant;
+        participant.electedTimestamp.assign(entry.electedTimestamp,
+                                            strnlen(entry.electedTimestamp, sizeof(entry.electedTimestamp)));
+        participant.hostname.assign(entry.hostname, strnlen(entry.hostname, sizeof(entry.hostname)));
+        participant.ip.assign(entry.ip, strnlen(entry.ip, sizeof(entry.ip)));
+        participant.mac.assign(entry.mac, strnlen(entry.mac, sizeof(entry.mac)));
+        participant.status = entry.status <= static_cast<uint8_t>(Table::ParticipantStatus::Manager)
+                ? static_cast<Table::ParticipantStatus>(entry.status)
+                : Table::ParticipantStatus::Unknown;
+        return participant;
+    }
+
+    bool TableStore::load(std::unordered_map<std::string, Table::Participant> &data, uint32_t &seq) {
+        data.clear();
+        seq = 0;
+        generation = 0;
+        if (!createDirectory())
+            return false;
+        loadSnapshot(data, seq);
+        replayLog(data, seq);
+
+        /* Compacts on startup, so the log always starts empty and matches the current snapshot generation */
+        return compact(seq, data);
+    }
+
+    bool TableStore::createDirectory() {
+        /* Creates every missing component of the path, as 'mkdir -p' */
+        for (size_t end = directory.find('/', 1); ; end = directory.find('/', end + 1)) {
+            std::string path = directory.substr(0, end);
+            if (!path.empty() && mkdir(path.c_str(), 0755) < 0 && errno != EEXIST) {
+                log->error("Table store: failed to create directory {}: {}", path, strerror(errno));
+                return false;
+            }
+            if (end == std::string::npos)
+                return true;
+        }
+    }
+
+    bool TableStore::loadSnapshot(std::unordered_map<std::string, Table::Participant> &data, uint32_t &seq) {
+        int fd = open(snapshotPath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+            close(fd);
+            return false;
+        }
+
+        void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            log->error("Table store: failed to map snapshot {}", snapshotPath);
+            return false;
+        }
+
+        const auto *header = reinterpret_cast<const FileHeader *>(addr);
+        size_t expected = sizeof(FileHeader) + header->noEntries * sizeof(StoredParticipant);
+        if (memcmp(header->magic, WAKEONLAN_STORE_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+            || header->version != WAKEONLAN_STORE_VERSION
+            || expected > static_cast<size_t>(st.st_size)) {
+            log->warn("Table store: ignoring invalid snapshot {}", snapshotPath);
+            munmap(addr, st.st_size);
+            return false;
+        }
+
+        const auto *entries = reinterpret_cast<const StoredParticipant *>(
+                static_cast<const char *>(addr) + sizeof(FileHeader));
+        for (uint32_t i = 0; i < header->noEntries; i++) {
+            Table::Participant participant = decode(entries[i]);
+            data[participant.hostname] = participant;
+        }
+        seq = header->seq;
+        generation = header->generation;
+        munmap(addr, st.st_size);
+        return true;
+    }
+
+    void TableStore::replayLog(std::unordered_map<std::string, Table::Participant> &data, uint32_t &seq) {
+        int fd = open(logPath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        FileHeader header{};
+        if (read(fd, &header, sizeof(header)) != sizeof(header)
+            || memcmp(header.magic, WAKEONLAN_STORE_LOG_MAGIC, sizeof(header.magic)) != 0
+            || header.version != WAKEONLAN_STORE_VERSION
+            || header.generation != generation) {
+            /* The log belongs to an older snapshot (crash in the middle of a compaction) */
+            close(fd);
+            return;
+        }
+
+        LogRecord record{};
+        uint32_t replayed = 0;
+        while (read(fd, &record, sizeof(record)) == sizeof(record)) {
+            Table::Participant participant = decode(record.entry);
+            switch (static_cast<Operation>(record.op)) {
+                case Operation::Insert:
+                case Operation::Update:
+                    data[participant.hostname] = participant;
+                    break;
+                case Operation::Remove:
+                    data.erase(participant.hostname);
+                    break;
+                default:
+                    log->warn("Table store: unknown WAL operation {}", (int)record.op);
+                    break;
+            }
+            seq = std::max(seq, record.seq);
+            replayed++;
+        }
+        close(fd);
+        log->info("Table store: replayed {} WAL records [seq={}]", replayed, seq);
+    }
+
+    bool TableStore::resetLog() {
+        if (logFd >= 0)
+            close(logFd);
+
+        logFd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (logFd < 0) {
+            log->error("Table store: failed to open WAL {}", logPath);
+            return false;
+        }
+
+        FileHeader header{};
+        memcpy(header.magic, WAKEONLAN_STORE_LOG_MAGIC, sizeof(header.magic));
+        header.version = WAKEONLAN_STORE_VERSION;
+        header.generation = generation;
+        if (write(logFd, &header, sizeof(header)) != sizeof(header)) {
+            log->error("Table store: failed to write WAL header");
+            return false;
+        }
+        records = 0;
+        return true;
+    }
+
+    void TableStore::append(Operation op, uint32_t seq, const Table::Participant &participant) {
+        if (logFd < 0)
+            return;
+
+        LogRecord record{};
+        record.op = static_cast<uint8_t>(op);
+        record.seq = seq;
+        encode(participant, record.entry);
+        if (write(logFd, &record, sizeof(record)) != sizeof(record))
+            log->error("Table store: failed to append WAL record [seq={}]", seq);
+        records++;
+    }
+
+    bool TableStore::needsCompaction() const {
+        return records >= WAKEONLAN_STORE_COMPACTION_THRESHOLD;
+    }
+
+    bool TableStore::compact(uint32_t seq, const std::unordered_map<std::string, Table::Participant> &data) {
+        std::string tmpPath = snapshotPath + ".tmp";
+        size_t size = sizeof(FileHeader) + data.size() * sizeof(StoredParticipant);
+
+        int fd = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            log->error("Table store: failed to create snapshot {}", tmpPath);
+            return false;
+        }
+        if (ftruncate(fd, size) != 0) {
+            log->error("Table store: failed to resize snapshot {}", tmpPath);
+            close(fd);
+            return false;
+        }
+        void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            log->error("Table store: failed to map snapshot {}", tmpPath);
+            close(fd);
+            return false;
+        }
+
+        auto *header = reinterpret_cast<FileHeader *>(addr);
+        memcpy(header->magic, WAKEONLAN_STORE_SNAPSHOT_MAGIC, sizeof(header->magic));
+        header->version = WAKEONLAN_STORE_VERSION;
+        header->generation = generation + 1;
+        header->seq = seq;
+        header->noEntries = data.size();
+
+        auto *entries = reinterpret_cast<StoredParticipant *>(static_cast<char *>(addr) + sizeof(FileHeader));
+        for (auto &entry : data)
+            encode(entry.second, *entries++);
+
+        msync(addr, size, MS_SYNC);
+        munmap(addr, size);
+        fsync(fd);
+        close(fd);
+
+        if (rename(tmpPath.c_str(), snapshotPath.c_str()) != 0) {
+            log->error("Table store: failed to install snapshot {}", snapshotPath);
+            return false;
+        }
+        generation++;
+        return resetLog();
+    }
+} // namespace WakeOnLanImpl
@@ -0,0 +1,131 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <../src/MessageTypes.hpp>
+#include <../src/common/Table.hpp>
+
+namespace WakeOnLanImpl {
+    /**
+     * @class TableStore
+     * This class implements the optional persistence layer of the ::Table. Every mutation applied to the
+     * table is appended to a write-ahead log (WAL) as a fixed-size record carrying the operation, the table
+     * sequence number and the affected row. Once the log grows past a threshold, the whole table is compacted
+     * into a snapshot file written through a memory mapping and the log is reset. On startup the snapshot is
+     * mapped back and the log is replayed on top of it, so a restarted host recovers its group immediately.
+     *
+     * The class is not thread-safe. The ::Table serializes the calls under its own lock.
+     */
+    class TableStore {
+    public:
+        /**
+         * @enum Operation
+         * The operation recorded on a WAL record.
+         */
+        enum class Operation : uint8_t {
+            Insert = 'I',   ///< A participant was inserted on the table.
+            Update = 'U',   ///< A participant had its row updated (status or elected timestamp).
+            Remove = 'R'    ///< A participant was removed from the table.
+        };
+
+        /**
+         * TableStore constructor.
+         * @param directory The directory holding the snapshot and the WAL files. It is created if needed.
+         */
+        explicit TableStore(const std::string &directory);
+
+        /**
+         * TableStore destructor. Closes the WAL file.
+         */
+        ~TableStore();
+
+        /**
+         * Loads the persisted table. The snapshot is mapped and decoded, then every WAL record belonging
+         * to the same generation of the snapshot is replayed in order. A torn record at the end of the log
+         * (e.g. after a crash in the middle of a write) is discarded.
+         *
+         * @param data The map receiving the recovered rows.
+         * @param seq The variable receiving the recovered table sequence number.
+         * @returns A bool indicating the store was opened with success (false when the directory cannot be created).
+         */
+        bool load(std::unordered_map<std::string, Table::Participant> &data, uint32_t &seq);
+
+        /**
+         * Appends a record to the WAL.
+         * @param op The operation applied to the table.
+         * @param seq The table sequence number after the operation.
+         * @param participant The affected row. Only the hostname is relevant for Remove.
+         * @returns None.
+         */
+        void append(Operation op, uint32_t seq, const Table::Participant &participant);
+
+        /**
+         * Indicates the WAL has grown enough to be compacted.
+         * @returns A bool indicating ::compact() should be called.
+         */
+        bool needsCompaction() const;
+
+        /**
+         * Writes a new snapshot containing the rows passed as argument and resets the WAL. The snapshot is
+         * written on a temporary file and atomically renamed over the previous one.
+         *
+         * @param seq The table sequence number the snapshot corresponds to.
+         * @param data The current table rows.
+         * @returns A bool indicating the snapshot was written.
+         */
+        bool compact(uint32_t seq, const std::unordered_map<std::string, Table::Participant> &data);
+    private:
+#pragma pack(push, 1)
+        /**
+         * @struct StoredParticipant
+         * The on-disk representation of a table row. Fields use the same sizes of the TableUpdate message.
+         */
+        struct StoredParticipant {
+            char electedTimestamp[WAKEONLAN_FIELD_TIMESTAMP_SIZE];
+            char hostname[WAKEONLAN_FIELD_HOSTNAME_SIZE];
+            char ip[WAKEONLAN_FIELD_IP_SIZE];
+            char mac[WAKEONLAN_FIELD_MAC_SIZE];
+            uint8_t status;
+        };
+
+        /**
+         * @struct FileHeader
+         * The header of both the snapshot and the WAL files.
+         */
+        struct FileHeader {
+            char magic[4];          ///< "WOLS" for snapshots, "WOLL" for logs.
+            uint32_t version;       ///< The file format version.
+            uint32_t generation;    ///< Snapshot generation. A log only applies to the snapshot of the same generation.
+            uint32_t seq;           ///< The table sequence number (snapshot only).
+            uint32_t noEntries;     ///< The number of rows (snapshot only).
+        };
+
+        /**
+         * @struct LogRecord
+         * A WAL record.
+         */
+        struct LogRecord {
+            uint8_t op;
+            uint32_t seq;
+            StoredParticipant entry;
+        };
+#pragma pack(pop)
+
+        static void encode(const Table::Participant &participant, StoredParticipant &entry);
+        static Table::Participant decode(const StoredParticipant &entry);
+
+        bool createDirectory();
+        bool loadSnapshot(std::unordered_map<std::string, Table::Participant> &data, uint32_t &seq);
+        void replayLog(std::unordered_map<std::string, Table::Participant> &data, uint32_t &seq);
+        bool resetLog();
+
+        std::string directory;                  ///< The directory holding the files.
+        std::string snapshotPath;               ///< The snapshot file path.
+        std::string logPath;                    ///< The WAL file path.
+        int logFd;                              ///< The WAL file descriptor.
+        uint32_t generation;                    ///< The current snapshot generation.
+        uint32_t records;                       ///< Records appended since the last compaction.
+        std::shared_ptr<spdlog::logger> log;    ///< The TableStore logger.
+    };
+} // namespace WakeOnLanImpl
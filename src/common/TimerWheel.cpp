@@ -0,0 +1,90 @@
+#include <../src/common/TimerWheel.hpp>
+
+namespace WakeOnLanImpl {
+#define WAKEONLAN_TIMER_WHEEL_SLOT_MASK (WAKEONLAN_TIMER_WHEEL_SLOTS - 1)
+
+    TimerWheel::TimerWheel(uint64_t res, uint64_t now)
+        : resolution(res ? res : 1),
+          currentTick(now / (res ? res : 1)),
+          nextId(1)
+    {}
+
+    TimerWheel::TimerId TimerWheel::schedule(const std::string &key, int tag, uint64_t deadline) {
+        Timer timer{nextId++, key, tag, deadline};
+        place(timer);
+        return timer.id;
+    }
+
+    bool TimerWheel::cancel(TimerId id) {
+        auto it = timers.find(id);
+        if (it == timers.end())
+            return false;
+        it->second.slot->erase(it->second.it);
+        timers.erase(it);
+        return true;
+    }
+
+    void TimerWheel::place(Timer timer) {
+        /* Rounds the deadline up, so a timer never expires before its deadline */
+        uint64_t tick = (timer.deadline + resolution - 1) / resolution;
+        if (tick < currentTick)
+            tick = currentTick;
+
+        uint64_t delta = tick - currentTick;
+        uint64_t maxDelta = (1ULL << (WAKEONLAN_TIMER_WHEEL_LEVELS * WAKEONLAN_TIMER_WHEEL_SLOT_BITS)) - 1;
+        if (delta > maxDelta) {
+            delta = maxDelta;
+            tick = currentTick + maxDelta;
+        }
+
+        int level = 0;
+        while (level < WAKEONLAN_TIMER_WHEEL_LEVELS - 1
+               && delta >= (1ULL << ((level + 1) * WAKEONLAN_TIMER_WHEEL_SLOT_BITS)))
+            level++;
+
+        Slot &slot = wheels[level][(tick >> (level * WAKEONLAN_TIMER_WHEEL_SLOT_BITS)) & WAKEONLAN_TIMER_WHEEL_SLOT_MASK];
+        TimerId id = timer.id;
+        slot.push_back(std::move(timer));
+        timers[id] = Location{&slot, std::prev(slot.end())};
+    }
+
+    void TimerWheel::cascade(int level) {
+        /* Moves the timers of the current slot of a coarse wheel to the finer wheels */
+        Slot slot;
+        slot.swap(wheels[level][(currentTick >> (level * WAKEONLAN_TIMER_WHEEL_SLOT_BITS)) & WAKEONLAN_TIMER_WHEEL_SLOT_MASK]);
+        for (auto &timer : slot) {
+            timers.erase(timer.id);
+            place(std::move(timer));
+        }
+    }
+
+    std::vector<TimerWheel::Timer> TimerWheel::advance(uint64_t now) {
+        std::vector<Timer> expired;
+        uint64_t nowTick = now / resolution;
+        while (currentTick <= nowTick) {
+            if (timers.empty()) {
+                currentTick = nowTick + 1;
+                break;
+            }
+
+            uint64_t index = currentTick & WAKEONLAN_TIMER_WHEEL_SLOT_MASK;
+            for (int level = 1; index == 0 && level < WAKEONLAN_TIMER_WHEEL_LEVELS; level++) {
+                cascade(level);
+                index = (currentTick >> (level * WAKEONLAN_TIMER_WHEEL_SLOT_BITS)) & WAKEONLAN_TIMER_WHEEL_SLOT_MASK;
+            }
+
+            Slot &slot = wheels[0][currentTick & WAKEONLAN_TIMER_WHEEL_SLOT_MASK];
+            for (auto &timer : slot) {
+                timers.erase(timer.id);
+                expired.push_back(std::move(timer));
+            }
+            slot.clear();
+            currentTick++;
+        }
+        return expired;
+    }
+
+    size_t TimerWheel::size() const {
+        return timers.size();
+    }
+} // namespace WakeOnLanImpl
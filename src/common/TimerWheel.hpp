@@ -0,0 +1,94 @@
+#pragma once
+#include <list>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace WakeOnLanImpl {
+#define WAKEONLAN_TIMER_WHEEL_LEVELS 4
+#define WAKEONLAN_TIMER_WHEEL_SLOT_BITS 6
+#define WAKEONLAN_TIMER_WHEEL_SLOTS (1 << WAKEONLAN_TIMER_WHEEL_SLOT_BITS)
+
+    /**
+     * @class TimerWheel
+     * This class implements a hierarchical timer wheel. Timers are kept on slots of a set of wheels with
+     * increasing granularity: the first wheel holds timers expiring in the next WAKEONLAN_TIMER_WHEEL_SLOTS ticks,
+     * and each following wheel covers WAKEONLAN_TIMER_WHEEL_SLOTS times the range of the previous one. As time
+     * advances, the timers of the coarse wheels are cascaded to the finer ones. Scheduling and canceling a timer
+     * are O(1), and advancing the wheel costs O(1) per tick plus the expired timers.
+     *
+     * The class is not thread-safe.
+     */
+    class TimerWheel {
+    public:
+        typedef uint64_t TimerId;
+
+        /**
+         * @struct Timer
+         * A timer scheduled on the wheel.
+         */
+        struct Timer {
+            TimerId id;             ///< The timer identifier.
+            std::string key;        ///< The key the timer belongs to (e.g. a participant hostname).
+            int tag;                ///< A user-defined tag telling timers of the same key apart.
+            uint64_t deadline;      ///< The deadline, in milliseconds.
+        };
+
+        /**
+         * TimerWheel constructor.
+         * @param resolution The duration of a tick, in milliseconds.
+         * @param now The current time, in milliseconds.
+         */
+        TimerWheel(uint64_t resolution, uint64_t now);
+
+        /**
+         * Schedules a timer. Deadlines in the past expire on the next call to ::advance().
+         * @param key The key the timer belongs to.
+         * @param tag The timer tag.
+         * @param deadline The deadline, in milliseconds.
+         * @returns The timer identifier, used to cancel it.
+         */
+        TimerId schedule(const std::string &key, int tag, uint64_t deadline);
+
+        /**
+         * Cancels a timer.
+         * @param id The timer identifier.
+         * @returns A bool indicating the timer was pending.
+         */
+        bool cancel(TimerId id);
+
+        /**
+         * Advances the wheel up to the time passed as argument.
+         * @param now The current time, in milliseconds.
+         * @returns The timers expired, in deadline order of their ticks.
+         */
+        std::vector<Timer> advance(uint64_t now);
+
+        /**
+         * Gets the number of pending timers.
+         * @returns The number of pending timers.
+         */
+        size_t size() const;
+    private:
+        typedef std::list<Timer> Slot;
+
+        /**
+         * @struct Location
+         * The slot holding a pending timer.
+         */
+        struct Location {
+            Slot *slot;
+            Slot::iterator it;
+        };
+
+        void place(Timer timer);
+        void cascade(int level);
+
+        uint64_t resolution;                                                        ///< The tick duration, in milliseconds.
+        uint64_t currentTick;                                                       ///< The next tick to be processed.
+        TimerId nextId;                                                             ///< The identifier of the next timer.
+        Slot wheels[WAKEONLAN_TIMER_WHEEL_LEVELS][WAKEONLAN_TIMER_WHEEL_SLOTS];     ///< The wheels.
+        std::unordered_map<TimerId, Location> timers;                               ///< The pending timers.
+    };
+} // namespace WakeOnLanImpl
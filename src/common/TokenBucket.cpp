@@ -0,0 +1,25 @@
+#include <algorithm>
+#include <../src/common/TokenBucket.hpp>
+
+namespace WakeOnLanImpl {
+    TokenBucket::TokenBucket(double r, double c, uint64_t now)
+        : rate(r / 1000.0),
+          capacity(std::max(c, 1.0)),
+          tokens(std::max(c, 1.0)),
+          last(now)
+    {}
+
+    bool TokenBucket::tryAcquire(uint64_t now) {
+        if (rate <= 0)
+            return true;
+
+        if (now > last) {
+            tokens = std::min(capacity, tokens + (now - last) * rate);
+            last = now;
+        }
+        if (tokens < 1.0)
+            return false;
+        tokens -= 1.0;
+        return true;
+    }
+} // namespace WakeOnLanImpl
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+namespace WakeOnLanImpl {
+    /**
+     * @class TokenBucket
+     * This class implements a token bucket rate limiter. Tokens are refilled at a constant rate up to the bucket
+     * capacity, and every send consumes one token, so the sends never exceed the rate for longer than a burst.
+     *
+     * The class is not thread-safe.
+     */
+    class TokenBucket {
+    public:
+        /**
+         * TokenBucket constructor.
+         * @param rate The refill rate, in tokens per second. A rate of 0 disables the limit.
+         * @param capacity The bucket capacity (the largest burst).
+         * @param now The current time, in milliseconds.
+         */
+        TokenBucket(double rate, double capacity, uint64_t now);
+
+        /**
+         * Consumes a token if one is available.
+         * @param now The current time, in milliseconds.
+         * @returns A bool indicating a token was consumed.
+         */
+        bool tryAcquire(uint64_t now);
+    private:
+        double rate;        ///< The refill rate, in tokens per millisecond.
+        double capacity;    ///< The bucket capacity.
+        double tokens;      ///< The available tokens.
+        uint64_t last;      ///< The time of the last refill.
+    };
+} // namespace WakeOnLanImpl
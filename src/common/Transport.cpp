@@ -0,0 +1,144 @@
+#include <../src/common/Transport.hpp>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#define LOCAL_SERVER_ADDRESS "0.0.0.0"
+#define BROADCAST_ADDRESS "255.255.255.255"
+
+namespace WakeOnLanImpl {
+    std::shared_ptr<Transport> Transport::create(const Config &config) {
+        switch (config.getTransportType()) {
+            case TransportType::UnixDatagram:
+                return std::make_shared<UnixTransport>(config.getUnixSocketDirectory(), config.getIpAddress());
+            case TransportType::Udp:
+            default:
+                return std::make_shared<UdpTransport>(config.getServicePort());
+        }
+    }
+
+    size_t Transport::sendBatch(const std::vector<Envelope> &batch) {
+        size_t sent = 0;
+        for (auto &envelope : batch)
+            if (send(*envelope.message, envelope.ip))
+                sent++;
+        return sent;
+    }
+
+    UdpTransport::UdpTransport(uint16_t port)
+        : port(port),
+          socket(LOCAL_SERVER_ADDRESS, port)
+    {}
+
+    sockaddr_in UdpTransport::destination(const std::string &ip) const {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = ip == BROADCAST_ADDRESS ? INADDR_BROADCAST : inet_addr(ip.c_str());
+        return address;
+    }
+
+    bool UdpTransport::send(const Message &message, const std::string &ip) {
+        return socket.sendTo(message, destination(ip));
+    }
+
+    size_t UdpTransport::sendBatch(const std::vector<Envelope> &batch) {
+        std::vector<const Message*> messages;
+        std::vector<sockaddr_in> destinations;
+        messages.reserve(batch.size());
+        destinations.reserve(batch.size());
+        for (auto &envelope : batch) {
+            messages.push_back(envelope.message);
+            destinations.push_back(destination(envelope.ip));
+        }
+        return socket.sendBatch(messages, destinations);
+    }
+
+    bool UdpTransport::broadcast(const Message &message) {
+        return socket.sendTo(message, destination(BROADCAST_ADDRESS));
+    }
+
+    bool UdpTransport::receive(Message &message, uint32_t timeoutMs) {
+        return socket.receive(&message, timeoutMs);
+    }
+
+    void UdpTransport::close() {
+        socket.closeSocket();
+    }
+
+    UnixTransport::UnixTransport(const std::string &dir, const std::string &ip)
+        : directory(dir),
+          path(dir + "/" + ip),
+          fd(-1)
+    {
+        mkdir(directory.c_str(), 0777);
+        if ((fd = socket(AF_UNIX, SOCK_DGRAM, 0)) < 0) {
+            perror("socket (AF_UNIX, SOCK_DGRAM, 0)");
+            exit(1);
+        }
+
+        struct sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            fprintf(stderr, "Unix socket path is too long: %s\n", path.c_str());
+            exit(1);
+        }
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        unlink(path.c_str()); // a stale socket left by a previous run
+        if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+            perror("error in bind unix socket");
+    }
+
+    UnixTransport::~UnixTransport() {
+        close();
+    }
+
+    bool UnixTransport::sendTo(const Message &message, const std::string &destination) {
+        struct sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, destination.c_str(), sizeof(address.sun_path) - 1);
+        return sendto(fd,
+                      &message,
+                      sizeof(message),
+                      MSG_DONTWAIT,
+                      (const struct sockaddr *) &address,
+                      sizeof(address)) == (ssize_t) sizeof(message);
+    }
+
+    bool UnixTransport::send(const Message &message, const std::string &ip) {
+        if (ip == BROADCAST_ADDRESS)
+            return broadcast(message);
+        return sendTo(message, directory + "/" + ip);
+    }
+
+    bool UnixTransport::broadcast(const Message &message) {
+        DIR *dir = opendir(directory.c_str());
+        if (dir == nullptr)
+            return false;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_type == DT_SOCK)
+                sendTo(message, directory + "/" + entry->d_name);
+        }
+        closedir(dir);
+        return true;
+    }
+
+    bool UnixTransport::receive(Message &message, uint32_t timeoutMs) {
+        struct pollfd pfd{};
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (fd < 0 || poll(&pfd, 1, timeoutMs) <= 0)
+            return false;
+        return recv(fd, &message, sizeof(Message), 0) > 0;
+    }
+
+    void UnixTransport::close() {
+        if (fd < 0)
+            return;
+        ::close(fd);
+        fd = -1;
+        unlink(path.c_str());
+    }
+} // namespace WakeOnLanImpl
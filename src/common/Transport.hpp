@@ -0,0 +1,134 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <../include/Config.hpp>
+#include <../src/MessageTypes.hpp>
+#include <../src/common/UdpSocket.hpp>
+
+using namespace WakeOnLan;
+
+namespace WakeOnLanImpl {
+    /**
+     * @struct Envelope
+     * A message and its destination, used on batched sends. The envelope points to the message, so a message sent
+     * to many hosts is not copied for each of them; the caller keeps it alive until the batch is sent.
+     */
+    struct Envelope {
+        std::string ip;             ///< The destination IP address (or the broadcast address).
+        const Message *message;     ///< The message.
+    };
+
+    /**
+     * @class Transport
+     * The interface the ::NetworkHandler uses to exchange messages with the other hosts. Messages are addressed by
+     * the IP address of the destination host, and the address '255.255.255.255' reaches every host of the segment.
+     * Only a single thread receives from a transport; any thread can send.
+     */
+    class Transport {
+    public:
+        virtual ~Transport() = default;
+
+        /**
+         * Creates the transport selected on the host configuration.
+         * @param config The host configuration.
+         * @returns The transport.
+         */
+        static std::shared_ptr<Transport> create(const Config &config);
+
+        /**
+         * Sends a message.
+         * @param message The message to be sent.
+         * @param ip The destination IP address (or the broadcast address).
+         * @returns A bool indicating the message was sent.
+         */
+        virtual bool send(const Message &message, const std::string &ip) = 0;
+
+        /**
+         * Sends a batch of messages, possibly to different hosts. Backends able to hand several messages to the
+         * system at once override it; the default sends them one by one.
+         * @param batch The messages and their destinations.
+         * @returns The number of messages sent.
+         */
+        virtual size_t sendBatch(const std::vector<Envelope> &batch);
+
+        /**
+         * Sends a message to every host of the segment (the local host included).
+         * @param message The message to be sent.
+         * @returns A bool indicating the message was sent.
+         */
+        virtual bool broadcast(const Message &message) = 0;
+
+        /**
+         * Receives a message, waiting for one up to the timeout.
+         * @param message The Message receiving the message.
+         * @param timeoutMs The maximum wait, in milliseconds.
+         * @returns A bool indicating a message was received.
+         */
+        virtual bool receive(Message &message, uint32_t timeoutMs) = 0;
+
+        /**
+         * Closes the transport. Messages are not received anymore.
+         * @returns None.
+         */
+        virtual void close() = 0;
+    };
+
+    /**
+     * @class UdpTransport
+     * The UDP transport. Messages are received on a socket bound to every interface of the host, and sent from the
+     * same socket to the same port of the destination host. Batches are handed to the kernel with a single system call.
+     */
+    class UdpTransport : public Transport {
+    public:
+        /**
+         * UdpTransport constructor.
+         * @param port The port messages are received on and sent to.
+         */
+        explicit UdpTransport(uint16_t port);
+
+        bool send(const Message &message, const std::string &ip) override;
+        size_t sendBatch(const std::vector<Envelope> &batch) override;
+        bool broadcast(const Message &message) override;
+        bool receive(Message &message, uint32_t timeoutMs) override;
+        void close() override;
+    private:
+        sockaddr_in destination(const std::string &ip) const;
+
+        uint16_t port;          ///< The service port.
+        UdpSocket socket;       ///< The socket bound to the service port.
+    };
+
+    /**
+     * @class UnixTransport
+     * The Unix datagram transport, for hosts sharing a file system (e.g. agents on containers of the same machine)
+     * without going through the IP stack. Every host binds a socket named by its IP address on a shared directory,
+     * and a broadcast reaches every socket of the directory.
+     */
+    class UnixTransport : public Transport {
+    public:
+        /**
+         * UnixTransport constructor.
+         * @param directory The directory holding the sockets of the hosts.
+         * @param ip The local host IP address, naming its socket.
+         */
+        UnixTransport(const std::string &directory, const std::string &ip);
+
+        /**
+         * UnixTransport destructor. Removes the host socket.
+         */
+        ~UnixTransport() override;
+
+        bool send(const Message &message, const std::string &ip) override;
+        bool broadcast(const Message &message) override;
+        bool receive(Message &message, uint32_t timeoutMs) override;
+        void close() override;
+    private:
+        bool sendTo(const Message &message, const std::string &path);
+
+        std::string directory;  ///< The directory holding the sockets of the hosts.
+        std::string path;       ///< The path of the host socket.
+        int fd;                 ///< The socket file descriptor (-1 when closed).
+    };
+} // namespace WakeOnLanImpl
@@ -1,7 +1,12 @@
 #include <../src/common/UdpSocket.hpp>
+#include <cerrno>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
 #define BROADCAST_ADDRESS "255.255.255.255"
 #define LOCAL_SERVER_ADDRESS "0.0.0.0"
+#define WAKEONLAN_SOCKET_SEND_ATTEMPTS 3
+#define WAKEONLAN_SOCKET_SEND_TIMEOUT 100
 
 namespace WakeOnLanImpl {
     UdpSocket::UdpSocket(const std::string &ip, const uint16_t &port) {
@@ -74,6 +79,60 @@ namespace WakeOnLanImpl {
         );
     }
 
+    bool UdpSocket::sendTo(const Message &message, const sockaddr_in &destination) {
+        return sendto(fd,
+                      &message,
+                      sizeof(message),
+                      0,
+                      (const struct sockaddr *) &destination,
+                      sizeof(destination)) == (ssize_t) sizeof(message);
+    }
+
+    size_t UdpSocket::sendBatch(const std::vector<const Message*> &messages,
+                                const std::vector<sockaddr_in> &destinations) {
+        std::vector<struct iovec> iovecs(messages.size());
+        std::vector<struct mmsghdr> headers(messages.size());
+        for (size_t i = 0; i < messages.size(); i++) {
+            iovecs[i].iov_base = const_cast<Message *>(messages[i]);
+            iovecs[i].iov_len = sizeof(Message);
+            memset(&headers[i], 0, sizeof(headers[i]));
+            headers[i].msg_hdr.msg_name = const_cast<sockaddr_in *>(&destinations[i]);
+            headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            headers[i].msg_hdr.msg_iov = &iovecs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        /**
+         * The kernel may take part of the batch, the rest is sent on the next calls. A full send buffer is waited
+         * for, and a message the kernel refuses is skipped so the messages after it are still sent
+         */
+        size_t sent = 0;
+        size_t next = 0;
+        int attempts = 0;
+        while (next < headers.size()) {
+            int n = sendmmsg(fd, headers.data() + next, headers.size() - next, 0);
+            if (n > 0) {
+                sent += n;
+                next += n;
+                attempts = 0;
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                && attempts++ < WAKEONLAN_SOCKET_SEND_ATTEMPTS) {
+                struct pollfd pfd{};
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+                poll(&pfd, 1, WAKEONLAN_SOCKET_SEND_TIMEOUT);
+                continue;
+            }
+            next++;
+            attempts = 0;
+        }
+        return sent;
+    }
+
     void UdpSocket::receive(Message * buffer) {
         size_t msg_size = sizeof(Message);
         struct sockaddr_in client_addr{};
@@ -86,6 +145,24 @@ namespace WakeOnLanImpl {
                          reinterpret_cast<socklen_t *>(&size));
     }
 
+    bool UdpSocket::receive(Message *buffer, uint32_t timeoutMs) {
+        struct pollfd pfd{};
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeoutMs) <= 0)
+            return false;
+
+        struct sockaddr_in client_addr{};
+        socklen_t size = sizeof(client_addr);
+        ssize_t n = recvfrom(fd,
+                             buffer,
+                             sizeof(Message),
+                             0,
+                             (struct sockaddr *) &client_addr,
+                             &size);
+        return n > 0;
+    }
+
     void UdpSocket::closeSocket() {
         close(fd);
     }
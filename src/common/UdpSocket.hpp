@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <cstring>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -36,6 +37,25 @@ namespace WakeOnLanImpl {
         void send(const Message &message);
         void send(const char * buffer, size_t size);
 
+        /**
+        * Sends a message to a given destination instead of the socket address.
+        *
+        * @param message The message to be sent.
+        * @param destination The destination address.
+        * @return A bool indicating the message was sent.
+        */
+        bool sendTo(const Message &message, const sockaddr_in &destination);
+
+        /**
+        * Sends a batch of messages with as few system calls as possible. While the send buffer is full the
+        * function waits for it to drain, and messages that still cannot be sent are skipped.
+        *
+        * @param messages The messages to be sent.
+        * @param destinations The destination address of each message.
+        * @return The number of messages sent.
+        */
+        size_t sendBatch(const std::vector<const Message*> &messages, const std::vector<sockaddr_in> &destinations);
+
         /**
         * Sends a magic packet.
          *
@@ -52,6 +72,15 @@ namespace WakeOnLanImpl {
         */
         void receive(Message *message);
 
+        /**
+        * Receives a message, waiting for one up to the timeout.
+        *
+        * @param message A pointer to a Message object for receiving the message.
+        * @param timeoutMs The maximum wait, in milliseconds.
+        * @return A bool indicating a message was received.
+        */
+        bool receive(Message *message, uint32_t timeoutMs);
+
         /**
         * Closes the UDP socket.
         *
@@ -1,20 +1,29 @@
 #include <../src/handler/Handler.hpp>
 
 namespace WakeOnLanImpl {
-    Handler::Handler(const Config &cfg, Table &t)
+#define WAKEONLAN_HANDLER_TICK 10
+
+    Handler::Handler(const Config &cfg,
+                     Table &t,
+                     std::shared_ptr<Clock> clock,
+                     std::shared_ptr<Transport> transport,
+                     bool interactive)
             : table(t),
-              config(cfg) {
-        networkHandler = std::make_shared<NetworkHandler>(4000, config);
+              config(cfg),
+              active(false) {
+        networkHandler = std::make_shared<NetworkHandler>(config, clock, transport);
         discoveryService = std::make_unique<DiscoveryService>(table, networkHandler);
         monitoringService = std::make_unique<MonitoringService>(table, networkHandler);
-        interfaceService = std::make_unique<InterfaceService>(table, networkHandler);
+        if (interactive && !config.getHeadless())
+            interfaceService = std::make_unique<InterfaceService>(table, networkHandler);
         electionService = std::make_unique<ElectionService>(table, networkHandler);
     }
 
     Handler::~Handler() {}
 
     void Handler::run() {
-        interfaceService->run();
+        if (interfaceService)
+            interfaceService->run();
         discoveryService->run();
         monitoringService->run();
         electionService->run();
@@ -23,6 +32,7 @@ namespace WakeOnLanImpl {
         t = std::make_unique<std::thread>([this]() {
             HandlerType electionResult;
             auto config = networkHandler->getDeviceConfig();
+            auto clock = networkHandler->getClock();
             while(active){
                 switch (networkHandler->getGlobalStatus())
                 {
@@ -32,13 +42,14 @@ namespace WakeOnLanImpl {
                     config = networkHandler->changeHandlerType(HandlerType::Participant);
                     discoveryService->notifyRoleChange();
                     monitoringService->notifyRoleChange();
-                    interfaceService->notifyRoleChange();
+                    if (interfaceService)
+                        interfaceService->notifyRoleChange();
                     break;
                 case ManagerFailure:
                     // 1. run an election 
                     networkHandler->setManagerIp("");
                     electionResult = electionService->startElection();
-                    while (!electionService->isElectionOver()){ }
+                    electionService->waitElectionOver();
                     
                     // 2. notify services if there is a status change
                     networkHandler->changeStatus(ServiceGlobalStatus::Synchronized);
@@ -47,7 +58,8 @@ namespace WakeOnLanImpl {
                         config = networkHandler->changeHandlerType(electionResult);
                         discoveryService->notifyRoleChange();
                         monitoringService->notifyRoleChange();
-                        interfaceService->notifyRoleChange();
+                        if (interfaceService)
+                            interfaceService->notifyRoleChange();
                     }
 
                     break;
@@ -60,24 +72,44 @@ namespace WakeOnLanImpl {
 
                         discoveryService->notifyRoleChange();
                         monitoringService->notifyRoleChange();
-                        interfaceService->notifyRoleChange();
+                        if (interfaceService)
+                            interfaceService->notifyRoleChange();
                     }
                     break;
                 }   
+                clock->sleepUntil(clock->now() + WAKEONLAN_HANDLER_TICK);
             }
         });
 
     }
 
+    ElectionStats Handler::getElectionStats() {
+        return electionService->getStats();
+    }
+
+    bool Handler::announceSleep() {
+        return monitoringService->announceSleep();
+    }
+
+    HandlerType Handler::getHandlerType() {
+        return networkHandler->getDeviceConfig().getHandlerType();
+    }
+
+    std::string Handler::getManagerIp() {
+        return networkHandler->getManagerIp();
+    }
+
     void Handler::stop() {
         active  = false;
+        if (t && t->joinable())
+            t->join();
 
         networkHandler->stop();
         discoveryService->stop();
         monitoringService->stop();
-        interfaceService->stop();
+        if (interfaceService)
+            interfaceService->stop();
         electionService->stop();
-        sleep(1);
     }
 
 }
\ No newline at end of file
@@ -19,8 +19,18 @@ namespace WakeOnLanImpl {
     public:
         /**
          * Handler constructor.
+         * @param config The API configuration.
+         * @param table The table used by the services.
+         * @param clock The clock used by the services. Default is the system clock.
+         * @param transport The transport used to exchange messages. Default is UDP on the service port.
+         * @param interactive Indicates the terminal interface is run, unless the configuration is headless.
+         *                    Simulated hosts run without it.
          */
-        Handler(const Config &config, Table& = Table::get());
+        Handler(const Config &config,
+                Table& = Table::get(),
+                std::shared_ptr<Clock> clock = Clock::system(),
+                std::shared_ptr<Transport> transport = nullptr,
+                bool interactive = true);
 
         /**
          * Handler virtual destructor.
@@ -38,10 +48,34 @@ namespace WakeOnLanImpl {
          * @returns None.
          */
         void stop();
+
+        /**
+         * Gets the elections observed by the services.
+         * @returns The election statistics.
+         */
+        ElectionStats getElectionStats();
+
+        /**
+         * Tells the manager the host is about to sleep.
+         * @returns A bool indicating the announcement was sent.
+         */
+        bool announceSleep();
+
+        /**
+         * Gets the current role of the host.
+         * @returns The handler type.
+         */
+        HandlerType getHandlerType();
+
+        /**
+         * Gets the IP address of the manager followed by the host.
+         * @returns The manager IP address (empty when the host does not follow a manager).
+         */
+        std::string getManagerIp();
     private:
         std::unique_ptr<DiscoveryService> discoveryService;             ///< The DiscoveryService instance.
         std::unique_ptr<MonitoringService> monitoringService;           ///< The MonitoringService instance.
-        std::unique_ptr<InterfaceService> interfaceService;             ///< The InterfaceService instance.
+        std::unique_ptr<InterfaceService> interfaceService;             ///< The InterfaceService instance (null when not interactive).
         std::unique_ptr<ElectionService> electionService;               ///< The ElectionService instance.
         std::shared_ptr<NetworkHandler> networkHandler;                 ///< The Network handler unique instance.
         Table& table;                                                   ///< The singleton table.
@@ -1,34 +1,57 @@
 #include <../src/handler/NetworkHandler.hpp>
-#define WON_PORT 9
-#define SERVICE_PORT 4000
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
 #define BROADCAST_ADDRESS "255.255.255.255"
-#define LOCAL_SERVER_ADDRESS "0.0.0.0"
+#define WAKEONLAN_STANDBY_ACK_TIMEOUT 100
+#define WAKEONLAN_STANDBY_MAX_ATTEMPTS 3
+#define WAKEONLAN_MULTICAST_BATCH 64
+#define WAKEONLAN_RECEIVE_TIMEOUT 100
+#define WAKEONLAN_MANAGER_STATE_FILE "manager.state"
+#define WAKEONLAN_FAILOVER_LEASE 300
 
 namespace WakeOnLanImpl {
-    NetworkHandler::NetworkHandler(const uint32_t &port, const Config &cfg)
-    : port(port),
+    NetworkHandler::NetworkHandler(const Config &cfg,
+                                   std::shared_ptr<Clock> clk,
+                                   std::shared_ptr<Transport> tr)
+    : discoveryFree(false),
+      monitoringFree(false),
+      electionFree(false),
+      port(cfg.getServicePort()),
       config(cfg),
+      clock(clk ? clk : Clock::system()),
+      transport(tr ? tr : Transport::create(cfg)),
       globalStatus(Unknown),
-      active(false)
+      leaseExpiry(0),
+      active(false),
+      lastUpdate(0, std::vector<Message>()),
+      epoch(drawEpoch()),
+      standbyAck(0),
+      standbyLagging(false)
     {
         log = spdlog::get("wakeonlan-api");
         log->info("Start Network handler");
 
-        t = std::make_unique<std::thread>([this, port](){
-            this->active = true;
-            UdpSocket socket(LOCAL_SERVER_ADDRESS, port);
+        this->active = true;
+        t = std::make_unique<std::thread>([this](){
             log->info("Network handler (internal): listening on port {}", port);
             while (active) {
                 Message response{};
                 response.type = Type::Unknown;
-                socket.receive(&response);
+                if (!transport->receive(response, WAKEONLAN_RECEIVE_TIMEOUT))
+                    continue;
 
                 if (response.type != Type::Unknown) {
+                    renewLease(response);
                     switch (response.type) {
                         case Type::SleepStatusRequest:
                         {
                             std::lock_guard<std::mutex> lk(inetMutex);
                             monitoringQueue.push(response);
+                            queueCv.notify_all();
                         }
                         break;
                         case Type::SleepServiceDiscovery:
@@ -36,12 +59,49 @@ namespace WakeOnLanImpl {
                         {
                             std::lock_guard<std::mutex> lk(inetMutex);
                             discoveryQueue.push(response);
+                            queueCv.notify_all();
                         }
                         break;
                         case Type::TableUpdate:
+                        case Type::TableUpdateNack:
+                        case Type::Heartbeat:
+                        case Type::SleepNotice:
                         {
                             std::lock_guard<std::mutex> lk(inetMutex);
                             monitoringQueue.push(response);
+                            queueCv.notify_all();
+                        }
+                        break;
+                        case Type::LeaseQuery:
+                            if (response.msgSeqNum == WAKEONLAN_LEASE_QUERY) {
+                                // answered by the listener, so a member answers whatever its role and status
+                                Message reply = response;
+                                reply.msgSeqNum = WAKEONLAN_LEASE_REPLY;
+                                bzero(reply.hostname, sizeof(reply.hostname));
+                                bzero(reply.ip, sizeof(reply.ip));
+                                bzero(reply.mac, sizeof(reply.mac));
+                                strncpy(reply.hostname, config.getHostname().c_str(), config.getHostname().size());
+                                strncpy(reply.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
+                                strncpy(reply.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+                                ManagerLease lease{getLeaseRemaining()};
+                                memcpy(reply.data, &lease, sizeof(lease));
+                                send(reply, std::string(response.ip, strnlen(response.ip, sizeof(response.ip))));
+                            }
+                            else {
+                                std::lock_guard<std::mutex> lk(inetMutex);
+                                discoveryQueue.push(response);
+                                queueCv.notify_all();
+                            }
+                        break;
+                        case Type::StandbyAck:
+                        {
+                            std::string senderIp(response.ip, strnlen(response.ip, sizeof(response.ip)));
+                            if (config.getStandby() == senderIp) {
+                                std::lock_guard<std::mutex> lk(standbyMutex);
+                                standbyAck = response.msgSeqNum;
+                                standbyLagging = false;
+                                standbyCv.notify_all();
+                            }
                         }
                         break;
                         case Type::ElectionServiceElection:
@@ -50,6 +110,7 @@ namespace WakeOnLanImpl {
                         {
                             std::lock_guard<std::mutex> lk(inetMutex);
                             electionQueue.push(response);
+                            queueCv.notify_all();
                         }
                         break;
                         default:
@@ -58,11 +119,22 @@ namespace WakeOnLanImpl {
                     }
                 }
             }
-            socket.closeSocket();
+            transport->close();
             log->info("Network handler (internal): listener socket is closed");
         });
     }
 
+    uint32_t NetworkHandler::drawEpoch() {
+        std::random_device random;
+        uint32_t value;
+        while ((value = random()) == 0);
+        return value;
+    }
+
+    uint32_t NetworkHandler::getEpoch() const {
+        return epoch.load();
+    }
+
     NetworkHandler::~NetworkHandler() {
         if (t->joinable()) {
             t->join();
@@ -70,102 +142,195 @@ namespace WakeOnLanImpl {
     }
 
     bool NetworkHandler::send(const Message &message, const std::string &ip) {
-        std::lock_guard<std::mutex> lk(inetMutex);
-        UdpSocket socket(ip, SERVICE_PORT);
-        socket.send(message);
-        socket.closeSocket();
-        return true;
+        if (ip == BROADCAST_ADDRESS)
+            return transport->broadcast(message);
+        return transport->send(message, ip);
+    }
+
+    size_t NetworkHandler::send(const std::vector<Envelope> &batch) {
+        size_t sent = transport->sendBatch(batch);
+        if (sent < batch.size())
+            log->warn("Sent {} of a batch of {} messages", sent, batch.size());
+        return sent;
     }
     
-    bool NetworkHandler::multicast(std::vector<Table::Participant> group, uint32_t seqNo)
-    {
-        Message multicastMsg{};
-        multicastMsg.type = Type::TableUpdate;
-        multicastMsg.msgSeqNum = seqNo;
-        bzero(multicastMsg.hostname, sizeof(multicastMsg.hostname));
-        bzero(multicastMsg.ip, sizeof(multicastMsg.ip));
-        bzero(multicastMsg.mac, sizeof(multicastMsg.mac));
-        strncpy(multicastMsg.hostname, config.getHostname().c_str(), config.getHostname().size());
-        strncpy(multicastMsg.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
-        strncpy(multicastMsg.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
-
-        size_t offset = 0;
-        uint8_t noEntries = group.size();
+    std::vector<Message> NetworkHandler::encodeTableUpdate(const std::vector<Table::Participant> &group,
+                                                           uint32_t seqNo) {
+        std::vector<Message> fragments;
+        size_t noFragments = group.empty()
+                ? 1
+                : (group.size() + WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES - 1) / WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES;
         char electedTimestamp[WAKEONLAN_FIELD_TIMESTAMP_SIZE];
         char host[WAKEONLAN_FIELD_HOSTNAME_SIZE];
         char ip[WAKEONLAN_FIELD_IP_SIZE];
         char mac[WAKEONLAN_FIELD_MAC_SIZE];
 
-        memcpy(&multicastMsg.data[offset], &noEntries, sizeof(noEntries));
-        offset += sizeof(noEntries);
-
-        /* Inserts table entries on the message */
-        for (auto & member : group) {
-            bzero(electedTimestamp, WAKEONLAN_FIELD_TIMESTAMP_SIZE);
-            bzero(host, WAKEONLAN_FIELD_HOSTNAME_SIZE);
-            bzero(ip, WAKEONLAN_FIELD_IP_SIZE);
-            bzero(mac, WAKEONLAN_FIELD_MAC_SIZE);
-
-            memcpy(electedTimestamp, member.electedTimestamp.c_str(), member.electedTimestamp.size());
-            memcpy(host, member.hostname.c_str(), member.hostname.size());
-            memcpy(ip, member.ip.c_str(), member.ip.size());
-            memcpy(mac, member.mac.c_str(), member.mac.size());
-
-            memcpy(&multicastMsg.data[offset], electedTimestamp, WAKEONLAN_FIELD_TIMESTAMP_SIZE);
-            offset += WAKEONLAN_FIELD_TIMESTAMP_SIZE;
-
-            memcpy(&multicastMsg.data[offset], host, WAKEONLAN_FIELD_HOSTNAME_SIZE);
-            offset += WAKEONLAN_FIELD_HOSTNAME_SIZE;
+        fragments.reserve(noFragments);
+        for (size_t fragment = 0; fragment < noFragments; fragment++) {
+            Message multicastMsg{};
+            multicastMsg.type = Type::TableUpdate;
+            multicastMsg.msgSeqNum = seqNo;
+            bzero(multicastMsg.hostname, sizeof(multicastMsg.hostname));
+            bzero(multicastMsg.ip, sizeof(multicastMsg.ip));
+            bzero(multicastMsg.mac, sizeof(multicastMsg.mac));
+            strncpy(multicastMsg.hostname, config.getHostname().c_str(), config.getHostname().size());
+            strncpy(multicastMsg.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
+            strncpy(multicastMsg.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+
+            size_t first = fragment * WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES;
+            TableUpdateHeader header{};
+            header.noEntries = std::min<size_t>(WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES, group.size() - first);
+            header.fragment = fragment;
+            header.noFragments = noFragments;
+            header.epoch = epoch;
+
+            size_t offset = 0;
+            memcpy(&multicastMsg.data[offset], &header, sizeof(header));
+            offset += sizeof(header);
+
+            /* Inserts table entries on the message */
+            for (size_t i = first; i < first + header.noEntries; i++) {
+                auto &member = group[i];
+                bzero(electedTimestamp, WAKEONLAN_FIELD_TIMESTAMP_SIZE);
+                bzero(host, WAKEONLAN_FIELD_HOSTNAME_SIZE);
+                bzero(ip, WAKEONLAN_FIELD_IP_SIZE);
+                bzero(mac, WAKEONLAN_FIELD_MAC_SIZE);
+
+                memcpy(electedTimestamp, member.electedTimestamp.c_str(),
+                       std::min<size_t>(member.electedTimestamp.size(), WAKEONLAN_FIELD_TIMESTAMP_SIZE));
+                memcpy(host, member.hostname.c_str(), std::min<size_t>(member.hostname.size(), WAKEONLAN_FIELD_HOSTNAME_SIZE));
+                memcpy(ip, member.ip.c_str(), std::min<size_t>(member.ip.size(), WAKEONLAN_FIELD_IP_SIZE));
+                memcpy(mac, member.mac.c_str(), std::min<size_t>(member.mac.size(), WAKEONLAN_FIELD_MAC_SIZE));
+
+                memcpy(&multicastMsg.data[offset], electedTimestamp, WAKEONLAN_FIELD_TIMESTAMP_SIZE);
+                offset += WAKEONLAN_FIELD_TIMESTAMP_SIZE;
+
+                memcpy(&multicastMsg.data[offset], host, WAKEONLAN_FIELD_HOSTNAME_SIZE);
+                offset += WAKEONLAN_FIELD_HOSTNAME_SIZE;
+
+                memcpy(&multicastMsg.data[offset], ip, WAKEONLAN_FIELD_IP_SIZE);
+                offset += WAKEONLAN_FIELD_IP_SIZE;
+
+                memcpy(&multicastMsg.data[offset], mac, WAKEONLAN_FIELD_MAC_SIZE);
+                offset += WAKEONLAN_FIELD_MAC_SIZE;
+
+                auto status = static_cast<uint8_t>(member.status);
+                memcpy(&multicastMsg.data[offset], &status, WAKEONLAN_FIELD_STATUS_SIZE);
+                offset += WAKEONLAN_FIELD_STATUS_SIZE;
+            }
+            fragments.push_back(multicastMsg);
+        }
+        return fragments;
+    }
 
-            memcpy(&multicastMsg.data[offset], ip, WAKEONLAN_FIELD_IP_SIZE);
-            offset += WAKEONLAN_FIELD_IP_SIZE;
+    bool NetworkHandler::multicast(std::vector<Table::Participant> group, uint32_t seqNo)
+    {
+        std::vector<Message> fragments = encodeTableUpdate(group, seqNo);
 
-            memcpy(&multicastMsg.data[offset], mac, WAKEONLAN_FIELD_MAC_SIZE);
-            offset += WAKEONLAN_FIELD_MAC_SIZE;
+        /* Keeps the encoded update for answering retransmission requests */
+        {
+            std::lock_guard<std::mutex> lk(historyMutex);
+            lastUpdate = std::make_pair(seqNo, fragments);
+        }
 
-            auto status = static_cast<uint8_t>(member.status);
-            memcpy(&multicastMsg.data[offset], &status, WAKEONLAN_FIELD_STATUS_SIZE);
-            offset += WAKEONLAN_FIELD_STATUS_SIZE;
+        /* The standby applies the update before any other member, so it never falls behind the group */
+        std::string standby = config.getStandby();
+        bool sentToStandby = false;
+        if (!standby.empty() && standby != config.getIpAddress()) {
+            for (auto &member : group) {
+                if (member.ip == standby && member.status == Table::ParticipantStatus::Awaken) {
+                    replicate(fragments, seqNo, standby);
+                    sentToStandby = true;
+                }
+            }
         }
 
-        log->info("Sending a MULTICAST message to the group [seq={} no_entries={}]", multicastMsg.msgSeqNum, noEntries);
+        log->info("Sending a MULTICAST message to the group [seq={} no_entries={} no_fragments={}]",
+                  seqNo, group.size(), fragments.size());
+        /* The members are sent their fragments in bounded batches, which point to the encoded fragments */
+        std::vector<Envelope> batch;
+        batch.reserve(WAKEONLAN_MULTICAST_BATCH + fragments.size());
+        size_t noMembers = 0;
+        size_t noSent = 0;
+        size_t noMessages = 0;
         for (auto & member : group) {
+            if (sentToStandby && member.ip == standby)
+                continue;
             if (member.status != Table::ParticipantStatus::Manager
                 && member.status != Table::ParticipantStatus::Unknown) {
-                send(multicastMsg, member.ip);
-                log->info("Sent a TableUpdate UNICAST message to {}", member.ip);
+                for (auto &fragment : fragments)
+                    batch.push_back(Envelope{member.ip, &fragment});
+                noMembers++;
+            }
+            if (batch.size() >= WAKEONLAN_MULTICAST_BATCH) {
+                noMessages += batch.size();
+                noSent += send(batch);
+                batch.clear();
             }
         }
-
+        if (!batch.empty()) {
+            noMessages += batch.size();
+            noSent += send(batch);
+        }
+        log->info("Sent a TableUpdate UNICAST message to {} members", noMembers);
+        return noSent == noMessages;
     }
 
-    Message* NetworkHandler::getFromDiscoveryQueue() {
-        std::lock_guard<std::mutex> lk(inetMutex);
-        static bool free = false;
-        if (free) {
-            discoveryQueue.pop();
+    bool NetworkHandler::replicate(const std::vector<Message> &fragments, uint32_t seqNo, const std::string &ip) {
+        std::unique_lock<std::mutex> lk(standbyMutex);
+        for (int attempt = 0; attempt < WAKEONLAN_STANDBY_MAX_ATTEMPTS; attempt++) {
+            lk.unlock();
+            for (auto &fragment : fragments)
+                send(fragment, ip);
+            lk.lock();
+
+            /* A lagging standby catches up without blocking the group */
+            if (standbyLagging)
+                return false;
+            if (clock->waitUntil(standbyCv, lk, clock->now() + WAKEONLAN_STANDBY_ACK_TIMEOUT,
+                                 [this, seqNo]() { return standbyAck >= seqNo; })) {
+                log->info("TableUpdate replicated to the standby {} [seq={}]", ip, seqNo);
+                return true;
+            }
         }
+        standbyLagging = true;
+        log->warn("Standby {} did not acknowledge TableUpdate {}, multicasting without it", ip, seqNo);
+        return false;
+    }
 
-        if (!discoveryQueue.empty()) {
-            Message * k = &discoveryQueue.front();
-            free = true;
-            return k;
-        }
-        else {
-            free = false;
-            return nullptr;
+    bool NetworkHandler::retransmit(uint32_t firstSeqNo, uint32_t lastSeqNo, const std::string &ip) {
+        std::vector<Message> fragments;
+        uint32_t seqNo;
+        {
+            std::lock_guard<std::mutex> lk(historyMutex);
+            /* Updates carry the whole table, so the latest one covers every missed update of the range */
+            if (lastUpdate.first == 0 || lastUpdate.first < lastSeqNo)
+                return false;
+            seqNo = lastUpdate.first;
+            fragments = lastUpdate.second;
         }
+
+        for (auto &fragment : fragments)
+            send(fragment, ip);
+        log->info("Retransmitted TableUpdate to {} [missed={}..{} seq={}]", ip, firstSeqNo, lastSeqNo, seqNo);
+        return true;
     }
 
-    Message* NetworkHandler::getFromMonitoringQueue() {
+    bool NetworkHandler::sendTable(const std::vector<Table::Participant> &group, uint32_t seqNo, const std::string &ip) {
+        for (auto &fragment : encodeTableUpdate(group, seqNo))
+            send(fragment, ip);
+        log->info("Sent a TableUpdate snapshot to {} [seq={} no_entries={}]", ip, seqNo, group.size());
+        return true;
+    }
+
+    Message* NetworkHandler::pop(std::queue<Message> &queue, bool &free) {
         std::lock_guard<std::mutex> lk(inetMutex);
-        static bool free = false;
         if (free) {
-            monitoringQueue.pop();
+            queue.pop();
         }
 
-        if (!monitoringQueue.empty()) {
-            Message * k = &monitoringQueue.front();
+        if (!queue.empty()) {
+            Message * k = &queue.front();
             free = true;
             return k;
         }
@@ -175,27 +340,39 @@ namespace WakeOnLanImpl {
         }
     }
 
+    Message* NetworkHandler::getFromDiscoveryQueue() {
+        return pop(discoveryQueue, discoveryFree);
+    }
+
+    Message* NetworkHandler::getFromMonitoringQueue() {
+        return pop(monitoringQueue, monitoringFree);
+    }
+
     Message* NetworkHandler::getFromElectionQueue() {
-        std::lock_guard<std::mutex> lk(inetMutex);
-        static bool free = false;
-        if (free) {
-            electionQueue.pop();
-        }
+        return pop(electionQueue, electionFree);
+    }
 
-        if (!electionQueue.empty()) {
-            Message * k = &electionQueue.front();
-            free = true;
-            return k;
-        }
-        else {
-            free = false;
-            return nullptr;
-        }
+    void NetworkHandler::waitForMessages(ServiceQueue queue, uint64_t deadline) {
+        std::unique_lock<std::mutex> lk(inetMutex);
+        /* The front message was already handed out when the queue is marked as free */
+        auto pending = [this, queue]() {
+            switch (queue) {
+                case ServiceQueue::Discovery:
+                    return discoveryQueue.size() > (discoveryFree ? 1u : 0u);
+                case ServiceQueue::Monitoring:
+                    return monitoringQueue.size() > (monitoringFree ? 1u : 0u);
+                case ServiceQueue::Election:
+                    return electionQueue.size() > (electionFree ? 1u : 0u);
+                default:
+                    return true;
+            }
+        };
+        clock->waitUntil(queueCv, lk, deadline, pending);
     }
 
     bool NetworkHandler::wakeUp(const std::string &mac) {
         std::lock_guard<std::mutex> lk(inetMutex);
-        UdpSocket socket(BROADCAST_ADDRESS, WON_PORT);
+        UdpSocket socket(BROADCAST_ADDRESS, config.getWakeOnLanPort());
         size_t pos;
         std::string delimiter = ":";
         std::string byte;
@@ -252,6 +429,12 @@ namespace WakeOnLanImpl {
     }
 
     Config NetworkHandler::changeHandlerType(const HandlerType &ht) {
+        if (ht == HandlerType::Manager && config.getHandlerType() != HandlerType::Manager) {
+            /* The table numbering of a new leadership is not comparable with the updates sent before */
+            epoch = drawEpoch();
+            std::lock_guard<std::mutex> lk(historyMutex);
+            lastUpdate = std::make_pair(0, std::vector<Message>());
+        }
         config.setHandlerType(ht);
         return config;
     }
@@ -263,13 +446,100 @@ namespace WakeOnLanImpl {
 
     const Config &NetworkHandler::getDeviceConfig() { return config; }
 
-    void NetworkHandler::setManagerIp(std::string ip) {managerIp = ip;}
+    std::shared_ptr<Clock> NetworkHandler::getClock() { return clock; }
+
+    void NetworkHandler::setManagerIp(std::string ip) {
+        bool changed;
+        {
+            std::lock_guard<std::mutex> lk(managerMutex);
+            changed = ip != managerIp;
+            if (changed)
+                leaseExpiry = 0; // a lease is only valid for the manager that granted it
+            managerIp = ip;
+        }
+        // the file is written outside the manager lock, so the lease checks do not wait for the disk
+        if (changed && !ip.empty() && !config.getPersistenceDirectory().empty())
+            saveManagerIp();
+    }
+
+    void NetworkHandler::saveManagerIp() {
+        std::lock_guard<std::mutex> lk(stateMutex);
+        // a later change may have been saved already: the current manager is the one written
+        std::string ip = getManagerIp();
+        if (ip.empty())
+            return;
+
+        std::string path = config.getPersistenceDirectory() + "/" + WAKEONLAN_MANAGER_STATE_FILE;
+        std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream state(tmpPath, std::ios::trunc);
+            state << ip << std::endl;
+            state.close();
+            if (state.fail()) {
+                log->error("Failed to write the manager state file {}", tmpPath);
+                std::remove(tmpPath.c_str());
+                return;
+            }
+        }
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            log->error("Failed to install the manager state file {}: {}", path, strerror(errno));
+            std::remove(tmpPath.c_str());
+        }
+    }
+
+    std::string NetworkHandler::getCachedManagerIp() {
+        std::string ip;
+        if (config.getPersistenceDirectory().empty())
+            return ip;
+        std::ifstream state(config.getPersistenceDirectory() + "/" + WAKEONLAN_MANAGER_STATE_FILE);
+        std::getline(state, ip);
+        return ip;
+    }
+
+    std::string NetworkHandler::getManagerIp() {
+        std::lock_guard<std::mutex> lk(managerMutex);
+        return managerIp;
+    }
 
-    std::string NetworkHandler::getManagerIp() {return managerIp;}
+    void NetworkHandler::grantLease(Message &message) {
+        /* On fast failover the lease is renewed by the frequent manager heartbeats, so it is kept short */
+        uint32_t duration = config.getLeaseDuration();
+        if (config.getElectionMode() == ElectionMode::FastFailover)
+            duration = std::min<uint32_t>(duration, WAKEONLAN_FAILOVER_LEASE);
+        ManagerLease lease{duration};
+        memcpy(message.data, &lease, sizeof(lease));
+    }
+
+    void NetworkHandler::renewLease(const Message &message) {
+        bool request = (message.type == Type::SleepStatusRequest && message.msgSeqNum == 1)
+                || (message.type == Type::SleepServiceDiscovery && message.msgSeqNum == 1)
+                || message.type == Type::Heartbeat;
+        if (!request)
+            return;
+
+        ManagerLease lease{};
+        memcpy(&lease, message.data, sizeof(lease));
+        std::string senderIp(message.ip, strnlen(message.ip, sizeof(message.ip)));
+        std::lock_guard<std::mutex> lk(managerMutex);
+        if (lease.duration == 0 || managerIp != senderIp)
+            return;
+        leaseExpiry = std::max(leaseExpiry, clock->now() + lease.duration);
+    }
+
+    bool NetworkHandler::isLeaseValid() {
+        return getLeaseRemaining() > 0;
+    }
+
+    uint32_t NetworkHandler::getLeaseRemaining() {
+        std::lock_guard<std::mutex> lk(managerMutex);
+        uint64_t now = clock->now();
+        return leaseExpiry > now ? leaseExpiry - now : 0;
+    }
 
     void NetworkHandler::stop() {
         active = false;
-        sleep(1);
+        if (t->joinable())
+            t->join();
         log->info("Stop Network handler");
     }
 } // namespace WakeOnLanImpl;
@@ -1,5 +1,7 @@
 #pragma once
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <queue>
 #include <thread>
 #include <memory>
@@ -9,6 +11,8 @@
 #include <../include/Config.hpp>
 #include <spdlog/spdlog.h>
 #include <../src/common/Table.hpp>
+#include <../src/common/Clock.hpp>
+#include <../src/common/Transport.hpp>
 
 using namespace WakeOnLan;
 
@@ -27,23 +31,37 @@ namespace WakeOnLanImpl {
         NotSynchronized = 5
     };
 
+    /**
+     * @enum ServiceQueue
+     * The queues buffering the messages designated to the API services.
+     */
+    enum class ServiceQueue {
+        Discovery,      ///< The Discovery service queue.
+        Monitoring,     ///< The Monitoring service queue.
+        Election        ///< The Election service queue.
+    };
+
     /**
      * @class NetworkHandler
      * This class is responsible for providing a broker engine to the API services,
      * abstracting the network handling from it through the encoding and decoding from
      * messages/network format to network format/messages. The handler creates a dedicated
-     * thread to binds a socket using the port passed to the class constructor for
-     * receiving messages designated to the running services. Messages are buffered on internal
+     * thread to receive, from the transport selected on the host configuration, the messages
+     * designated to the running services. Messages are buffered on internal
      * queues and a class user can recovery messages received by the handler calling the appropriated functions.
      */
     class NetworkHandler {
     public:
         /**
          * NetworkHandler constructor
-         * @param port The port used in the bound socket created to receive messages.
          * @param config The host configuration
+         * @param clock The clock used by the services. Default is the system clock.
+         * @param transport The transport used to exchange messages. Default is the transport selected on the
+         * configuration, on the configured service port.
          */
-        explicit NetworkHandler(const uint32_t &port, const Config &config);
+        explicit NetworkHandler(const Config &config,
+                                std::shared_ptr<Clock> clock = Clock::system(),
+                                std::shared_ptr<Transport> transport = nullptr);
 
         /**
          * NetworkHandler destructor
@@ -62,8 +80,49 @@ namespace WakeOnLanImpl {
         */
         bool send(const Message &message, const std::string &ip);
 
+        /**
+         * Sends a batch of messages, possibly to different hosts, handing them to the transport at once.
+         *
+         * @param batch The messages and their destinations.
+         * @returns The number of messages sent.
+         */
+        size_t send(const std::vector<Envelope> &batch);
+
+        /**
+         * Sends a table update to every synchronized member of the group. The update is split in fragments
+         * and the latest one is kept, so it can be retransmitted to participants that missed it. When a
+         * standby is designated and awake, the update is first replicated to it and the function waits for its
+         * acknowledgement before sending the update to the other members. The members are sent the update in
+         * bounded batches.
+         *
+         * @param group The table rows.
+         * @param seqNo The table sequence number.
+         * @returns A bool indicating the update was sent to every member.
+         */
         bool multicast(std::vector<Table::Participant> group, uint32_t seqNo);
 
+        /**
+         * Retransmits to a participant the latest table update, answering a TableUpdateNack. Since updates
+         * carry the whole table, the latest update covers the missed range when its sequence number is not
+         * older than the last missed one, so older updates are not kept.
+         *
+         * @param firstSeqNo The first missed sequence number.
+         * @param lastSeqNo The last missed sequence number.
+         * @param ip The participant IP address.
+         * @returns A bool indicating the latest update covered the range. When false, the caller must send a snapshot.
+         */
+        bool retransmit(uint32_t firstSeqNo, uint32_t lastSeqNo, const std::string &ip);
+
+        /**
+         * Sends the table to a single participant.
+         *
+         * @param group The table rows.
+         * @param seqNo The table sequence number.
+         * @param ip The participant IP address.
+         * @returns A bool indicating the table was sent.
+         */
+        bool sendTable(const std::vector<Table::Participant> &group, uint32_t seqNo, const std::string &ip);
+
         /**
          * Gets the older Message from the Discovery service queue. Messages of type SleepServiceDiscovery and
          * SleepServiceExit received by the handler are placed on a dedicated queue and can be gotten through this
@@ -76,8 +135,8 @@ namespace WakeOnLanImpl {
         Message* getFromDiscoveryQueue();
 
         /**
-         * Gets the older Message from the Monitoring service queue. Messages of type SleepStatusRequest
-         * received by the handler are placed on a dedicated queue and can be gotten through this
+         * Gets the older Message from the Monitoring service queue. Messages of type SleepStatusRequest,
+         * TableUpdate, TableUpdateNack and Heartbeat received by the handler are placed on a dedicated queue and can be gotten through this
          * function. Every message returned by the function is removed from the queue, so reading from the queue
          * is a unitary operation on the perspective of the specific message being recovered. In case of the queue
          * is empty a nullptr is returned, indicating there are not messages in the queue.
@@ -97,6 +156,15 @@ namespace WakeOnLanImpl {
          */
         Message* getFromElectionQueue();
 
+        /**
+         * Blocks until a message not yet gotten is on a service queue, or until the deadline passes. Services
+         * call it between iterations instead of polling their queue.
+         * @param queue The service queue.
+         * @param deadline The deadline, in milliseconds of the handler clock.
+         * @returns None.
+         */
+        void waitForMessages(ServiceQueue queue, uint64_t deadline);
+
         /**
          * Sends a WOL packet to a target host.
          * @param mac A MAC address in string format.
@@ -110,6 +178,12 @@ namespace WakeOnLanImpl {
          */
         const Config & getDeviceConfig();
 
+        /**
+         * Gets the clock used by the services.
+         * @returns A shared pointer to the clock.
+         */
+        std::shared_ptr<Clock> getClock();
+
         /**
          * Updates the global service status.
          * @returns None.
@@ -117,11 +191,17 @@ namespace WakeOnLanImpl {
         void changeStatus(const ServiceGlobalStatus &gs);
 
         /**
-         * Updates handler type 
+         * Updates handler type. A host becoming manager draws a new epoch for its table updates.
          * @returns New Config for the system.
          */
         Config changeHandlerType(const HandlerType &ht);
 
+        /**
+         * Gets the epoch of the table updates sent as manager.
+         * @returns The epoch.
+         */
+        uint32_t getEpoch() const;
+
         /**
          * Gets the global status.
          * @returns A const ServiceGlobalStatus reference.
@@ -129,11 +209,18 @@ namespace WakeOnLanImpl {
         const ServiceGlobalStatus& getGlobalStatus();
 
         /**
-         * Set the latest manager's IP address
+         * Set the latest manager's IP address. When table persistence is enabled, the address is also kept on a
+         * state file of the persistence directory, so a restarted participant rejoins through it.
          * @param ip , string with the IP address. 
          */
         void setManagerIp(std::string ip);
 
+        /**
+         * Gets the manager IP address kept on the state file by a previous run.
+         * @return The IP address, or an empty string when there is none (or persistence is disabled).
+         */
+        std::string getCachedManagerIp();
+
         /**
          * Get the current manager's IP address or 
          * an empty string if thre's no manager set
@@ -141,23 +228,100 @@ namespace WakeOnLanImpl {
          */
         std::string getManagerIp();
 
+        /**
+         * Writes the manager lease on a request sent by the manager.
+         * @param message The SleepStatusRequest, Heartbeat or SleepServiceDiscovery request.
+         */
+        void grantLease(Message &message);
+
+        /**
+         * Indicates the lease granted by the current manager has not expired.
+         * @return A bool indicating the lease is valid.
+         */
+        bool isLeaseValid();
+
+        /**
+         * Gets the remaining time of the lease granted by the current manager.
+         * @return The remaining time, in milliseconds (0 when expired).
+         */
+        uint32_t getLeaseRemaining();
+
         /**
          * Stops the Network handler.
          * @return None.
          */
         void stop();
     private:
+        /**
+         * Encodes a table update in fragments of up to WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES entries.
+         * @param group The table rows.
+         * @param seqNo The table sequence number.
+         * @return The TableUpdate messages composing the update.
+         */
+        std::vector<Message> encodeTableUpdate(const std::vector<Table::Participant> &group, uint32_t seqNo);
+
+        /**
+         * Renews the lease of the current manager when the message is a manager request granting one.
+         * @param message The received message.
+         */
+        void renewLease(const Message &message);
+
+        /**
+         * Draws a manager epoch (never 0).
+         */
+        static uint32_t drawEpoch();
+
+        /**
+         * Gets the front message of a queue, removing the message gotten on the previous call.
+         * @param queue The queue.
+         * @param free The flag indicating the front message was already gotten.
+         * @return A pointer to the message, or nullptr when the queue is empty.
+         */
+        Message* pop(std::queue<Message> &queue, bool &free);
+
+        /**
+         * Sends a table update to the standby and waits for its acknowledgement. A standby that misses every attempt
+         * is marked as lagging: the following updates are sent to it without waiting, until it acknowledges one.
+         * @param fragments The TableUpdate messages composing the update.
+         * @param seqNo The table sequence number.
+         * @param ip The standby IP address.
+         * @return A bool indicating the standby acknowledged the update.
+         */
+        bool replicate(const std::vector<Message> &fragments, uint32_t seqNo, const std::string &ip);
+
+        /**
+         * Writes the current manager IP address on the state file. The address is written on a temporary file
+         * renamed over the previous one, so a crash never leaves a truncated state file.
+         */
+        void saveManagerIp();
+
         std::unique_ptr<std::thread> t;         ///< The thread used to receive messages.
         std::mutex inetMutex;                   ///< The mutex for controlling internal issues.
         std::queue<Message> discoveryQueue;     ///< The queue buffering messages designated to the Discovery service.
         std::queue<Message> monitoringQueue;    ///< The queue buffering messages designated to the Monitoring service.
         std::queue<Message> electionQueue;      ///< The queue buffering messages designated to the Election service.
+        std::condition_variable queueCv;        ///< Notified when a message is placed on a queue.
+        bool discoveryFree;                     ///< Indicates the front of the Discovery queue was already gotten.
+        bool monitoringFree;                    ///< Indicates the front of the Monitoring queue was already gotten.
+        bool electionFree;                      ///< Indicates the front of the Election queue was already gotten.
         uint32_t  port;                         ///< The port the handler service is running on.
         Config config;                          ///< The API configuration.
+        std::shared_ptr<Clock> clock;           ///< The clock used by the services.
+        std::shared_ptr<Transport> transport;   ///< The transport used to exchange messages.
         ServiceGlobalStatus globalStatus;       ///< The services global status.
         std::mutex gsMutex;                     ///< The mutex used to handle global status access.
         std::string managerIp;                  ///< The IP address of the current manager.
+        std::mutex managerMutex;                ///< The mutex used to handle the manager IP and lease access.
+        uint64_t leaseExpiry;                   ///< The time (ms) the lease granted by the current manager expires.
+        std::mutex stateMutex;                  ///< The mutex used to serialize the manager state file writes.
         std::shared_ptr<spdlog::logger> log;    ///< The Network handler logger.
         bool active;                            ///< The bool indicating whether service is active or not.
+        std::mutex historyMutex;                ///< The mutex used to handle the latest update access.
+        std::pair<uint32_t, std::vector<Message>> lastUpdate; ///< The latest encoded table update (sequence number 0 when none).
+        std::atomic<uint32_t> epoch;            ///< The epoch of the table updates sent as manager.
+        std::mutex standbyMutex;                ///< The mutex used to handle the standby acknowledgement access.
+        std::condition_variable standbyCv;      ///< Notified when the standby acknowledges an update.
+        uint32_t standbyAck;                    ///< The last table sequence number acknowledged by the standby.
+        bool standbyLagging;                    ///< Indicates the standby missed an update and is not waited for.
     };
 } // namespace WakeOnLanImpl
\ No newline at end of file
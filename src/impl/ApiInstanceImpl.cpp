@@ -28,11 +28,32 @@ namespace WakeOnLanImpl {
             log->info("Hostname: {}", this->config.getHostname());
             log->info("IP Address: {}", this->config.getIpAddress());
             log->info("MAC Address: {}", this->config.getMacAddress());
+            if (this->config.getHeadless())
+                log->info("Running headless, without the terminal interface");
         } catch (spdlog::spdlog_ex &e) {
             std::cout << "Log init failed: " << e.what() << std::endl;
         }
 
-        handler = std::make_unique<Handler>(config);
+        /* Table persistence */
+        if (!this->config.getPersistenceDirectory().empty()) {
+            size_t restored = Table::get().enablePersistence(this->config.getPersistenceDirectory());
+            log->info("Restored {} group members from {}", restored, this->config.getPersistenceDirectory());
+
+            /* A restarted manager resumes its role with the recovered group */
+            auto manager = Table::get().get_manager();
+            if (manager.status == Table::ParticipantStatus::Manager
+                && manager.mac == this->config.getMacAddress()) {
+                this->config.setHandlerType(HandlerType::Manager);
+                log->info("Resuming as Manager of the recovered group");
+            }
+            else if (restored != 0) {
+                /* A restarted participant shows the cached group until the manager confirms it */
+                Table::get().setStale(true);
+                log->info("Showing the recovered group as stale until the manager confirms it");
+            }
+        }
+
+        handler = std::make_unique<Handler>(this->config);
     }
 
     ApiInstanceImpl::~ApiInstanceImpl() {}
@@ -46,4 +67,33 @@ namespace WakeOnLanImpl {
         handler->stop();
         log->info("Stopping handler");
     }
+
+    TableChanges ApiInstanceImpl::waitForTableChanges(uint64_t version, uint32_t timeoutMs) {
+        auto changeSet = Table::get().waitForChanges(version, std::chrono::milliseconds(timeoutMs));
+
+        TableChanges tableChanges;
+        tableChanges.version = changeSet.version;
+        tableChanges.reset = changeSet.reset;
+        tableChanges.stale = changeSet.stale;
+        tableChanges.changes.reserve(changeSet.changes.size());
+        for (auto &change : changeSet.changes) {
+            TableChange tableChange;
+            tableChange.type = static_cast<TableChangeType>(change.type);
+            tableChange.member.hostname = change.participant.hostname;
+            tableChange.member.ip = change.participant.ip;
+            tableChange.member.mac = change.participant.mac;
+            tableChange.member.electedTimestamp = change.participant.electedTimestamp;
+            tableChange.member.status = static_cast<MemberStatus>(change.participant.status);
+            tableChanges.changes.push_back(tableChange);
+        }
+        return tableChanges;
+    }
+
+    ElectionStats ApiInstanceImpl::getElectionStats() {
+        return handler->getElectionStats();
+    }
+
+    bool ApiInstanceImpl::announceSleep() {
+        return handler->announceSleep();
+    }
 }
@@ -30,6 +30,26 @@ namespace WakeOnLanImpl {
          * Stops the API services.
          */
         void stop();
+
+        /**
+         * Waits for changes on the group table.
+         * @param version The last table version seen by the caller.
+         * @param timeoutMs The maximum time to wait, in milliseconds.
+         * @return The changes after the version.
+         */
+        TableChanges waitForTableChanges(uint64_t version, uint32_t timeoutMs);
+
+        /**
+         * Gets the elections observed by the handler.
+         * @return The election statistics.
+         */
+        ElectionStats getElectionStats();
+
+        /**
+         * Tells the manager the host is about to sleep.
+         * @return A bool indicating the announcement was sent.
+         */
+        bool announceSleep();
     private:
         Config config;                          ///< The API configuration.
         std::unique_ptr<Handler> handler;       ///< The API handler.
@@ -1,19 +1,32 @@
 #include <../src/service/DiscoveryService.hpp>
 #include <memory>
+#include <unordered_set>
 
 namespace WakeOnLanImpl {
 #define WAKEONLAN_SYN 1
 #define WAKEONLAN_SYN_ACK 2
+#define WAKEONLAN_JOIN 3
 #define WAKEONLAN_BROADCAST_ADDRESS "255.255.255.255"
-#define WAKEONLAN_DISCOVERY_REQUEST_WINDOW 10
-#define WAKEONLAN_DISCOVERY_TIMEOUT 12 
+#define WAKEONLAN_DISCOVERY_MIN_INTERVAL 500
+#define WAKEONLAN_DISCOVERY_TIMEOUT 12000
+#define WAKEONLAN_DISCOVERY_TIMEOUT_GRACE 2000
+#define WAKEONLAN_DISCOVERY_FAILOVER_TIMEOUT 1000
+#define WAKEONLAN_LEASE_QUORUM_TIMEOUT 1000
+#define WAKEONLAN_DISCOVERY_TICK 100
+#define WAKEONLAN_JOIN_RETRY 250
+#define WAKEONLAN_JOIN_MAX_ATTEMPTS 4
+#define WAKEONLAN_JOIN_COALESCE_WINDOW 50
 
     DiscoveryService::DiscoveryService(Table &t, std::shared_ptr<NetworkHandler> nh)
-        : table(t),
+        : active(false),
+        lastTimestamp(0),
+        discoveryInterval(WAKEONLAN_DISCOVERY_MIN_INTERVAL),
+        table(t),
         inetHandler(nh),
-        active(false),
-        lastTimestamp(0)
-    {}
+        clock(nh->getClock())
+    {
+        quorum.active = false;
+    }
 
     DiscoveryService::~DiscoveryService() {
         if (t) {
@@ -29,7 +42,13 @@ namespace WakeOnLanImpl {
         active = true;
         t = std::make_unique<std::thread>([this](){
             auto config = inetHandler->getDeviceConfig();
-            lastTimestamp = std::time(nullptr) - WAKEONLAN_DISCOVERY_REQUEST_WINDOW;
+            uint64_t suspendMark = clock->suspendedTime();
+            uint64_t maxInterval = std::max<uint64_t>(config.getMaxDiscoveryInterval(), WAKEONLAN_DISCOVERY_MIN_INTERVAL);
+            lastTimestamp = 0;
+            discoveryInterval = WAKEONLAN_DISCOVERY_MIN_INTERVAL; // a new manager starts with a burst
+            table.setStale(false); // the manager owns the table
+            std::vector<Table::Mutation> batch;
+            uint64_t batchDeadline = 0;
             while (active) {
                 Message *m;
                 if (inetHandler->getGlobalStatus() == Unknown) {
@@ -37,12 +56,12 @@ namespace WakeOnLanImpl {
                 }
 
                 if (inetHandler->getGlobalStatus() == Synchronized) {
-                    /* Sent a broadcast packet each 10 seconds */
-                    if (lastTimestamp < (std::time(nullptr) - WAKEONLAN_DISCOVERY_REQUEST_WINDOW)) {
-                        if(lastTimestamp > 0 && (std::time(nullptr) - (lastTimestamp + WAKEONLAN_DISCOVERY_REQUEST_WINDOW)) > 2)
+                    /* Broadcasts are backed off while the group is stable, from a burst up to the maximum interval */
+                    if (lastTimestamp == 0 || clock->now() >= lastTimestamp + discoveryInterval) {
+                        if(clock->suspendedSince(suspendMark))
                         {
-                            log->info("Probably fell asleep");
-                            lastTimestamp = std::time(nullptr);
+                            log->info("Host was suspended");
+                            lastTimestamp = clock->now();
                             inetHandler->changeStatus(ServiceGlobalStatus::NotSynchronized);
                         }
                         else{
@@ -55,14 +74,21 @@ namespace WakeOnLanImpl {
                             strncpy(broadcastMsg.hostname, config.getHostname().c_str(), config.getHostname().size());
                             strncpy(broadcastMsg.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
                             strncpy(broadcastMsg.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+                            inetHandler->grantLease(broadcastMsg);
                             inetHandler->send(broadcastMsg, WAKEONLAN_BROADCAST_ADDRESS);
 
-                            lastTimestamp = std::time(nullptr);
+                            lastTimestamp = clock->now();
+                            discoveryInterval = std::min(discoveryInterval * 2, maxInterval);
                         }
                     }
 
-                    m = inetHandler->getFromDiscoveryQueue();
-                    if (m != nullptr) {
+                    /**
+                     * Joins and exits are gathered over a short window and applied on a single table batch, so the
+                     * replies to a broadcast reaching a large segment end up on a single table update instead of one each
+                     */
+                    if (batch.empty())
+                        batchDeadline = clock->now() + WAKEONLAN_JOIN_COALESCE_WINDOW;
+                    while ((m = inetHandler->getFromDiscoveryQueue()) != nullptr) {
                         switch (m->type) {
                             case Type::SleepServiceDiscovery:
                                 if (m->msgSeqNum == WAKEONLAN_SYN_ACK) {
@@ -72,22 +98,27 @@ namespace WakeOnLanImpl {
                                     newParticipant.hostname = m->hostname;
                                     newParticipant.status = Table::ParticipantStatus::Unknown;
                                     newParticipant.electedTimestamp = (char*)"N/A";
+                                    batch.push_back(Table::Mutation{Table::MutationType::Insert, newParticipant});
+                                }
+                                else if (m->msgSeqNum == WAKEONLAN_JOIN) {
+                                    /* A host announcing itself gets the SYN right away instead of on the next broadcast */
+                                    Message syn{};
+                                    syn.type = WakeOnLanImpl::Type::SleepServiceDiscovery;
+                                    syn.msgSeqNum = WAKEONLAN_SYN;
+                                    bzero(syn.hostname, sizeof(syn.hostname));
+                                    bzero(syn.ip, sizeof(syn.ip));
+                                    bzero(syn.mac, sizeof(syn.mac));
+                                    strncpy(syn.hostname, config.getHostname().c_str(), config.getHostname().size());
+                                    strncpy(syn.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
+                                    strncpy(syn.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+                                    inetHandler->grantLease(syn);
+                                    inetHandler->send(syn, m->ip);
 
-                                    auto ret = table.insert(newParticipant);
-                                    if ( ret.first != 0) {
-                                        log->info("Participant has joined the group [Hostname={}, IP={}, MAC={}]",
-                                                  newParticipant.hostname, newParticipant.ip, newParticipant.mac);
-
-                                        /**
-                                         * Send multicast message
-                                         */
-                                        /* Manager information */
-                                        inetHandler->multicast(ret.second, ret.first);
-                                    }
-                                    else {
-                                        log->warn("Failed to insert participant on the group [Hostname={}, IP={}, MAC={}]",
-                                                  newParticipant.hostname, newParticipant.ip, newParticipant.mac);
-                                    }
+                                    /* A member that just woke up is awake: no need to wait for its next probe */
+                                    Table::Participant member;
+                                    member.hostname = m->hostname;
+                                    member.status = Table::ParticipantStatus::Awaken;
+                                    batch.push_back(Table::Mutation{Table::MutationType::Update, member});
                                 }
                                          // SYNC message                  // sender's mac is different from self's
                                 // else if (m->msgSeqNum == WAKEONLAN_SYN && config.getMacAddress().compare(m->mac) != 0) { 
@@ -107,20 +138,75 @@ namespace WakeOnLanImpl {
                                 break;
                             case Type::SleepServiceExit:
                             {
-                                auto ret = table.remove(m->hostname);
-                                if (ret.first)
-                                {
-                                    log->info("Participant was removed from the group [Hostname={}, IP={}, MAC={}]",
-                                              m->hostname, m->ip,m->mac);
-                                    inetHandler->multicast(ret.second, ret.first);
-                                }
+                                Table::Participant leaving;
+                                leaving.ip = m->ip;
+                                leaving.mac = m->mac;
+                                leaving.hostname = m->hostname;
+                                leaving.status = Table::ParticipantStatus::Unknown;
+                                batch.push_back(Table::Mutation{Table::MutationType::Remove, leaving});
                             }
                                 break;
                             default:
                                 break;
                         }
                     }
+
+                    if (!batch.empty() && clock->now() >= batchDeadline) {
+                        std::vector<Table::Change> changes;
+                        auto ret = table.applyBatch(batch, &changes);
+                        std::unordered_set<std::string> changed;
+                        for (auto &change : changes)
+                            changed.insert(change.participant.hostname);
+                        for (auto &mutation : batch) {
+                            auto &p = mutation.participant;
+                            bool applied = changed.count(p.hostname) != 0;
+                            if (mutation.type == Table::MutationType::Insert && applied)
+                                log->info("Participant has joined the group [Hostname={}, IP={}, MAC={}]",
+                                          p.hostname, p.ip, p.mac);
+                            else if (mutation.type == Table::MutationType::Insert) {
+                                /**
+                                 * A restarted member joins again: it is probed and gets the table right away, instead
+                                 * of waiting for its next probe and the next table change
+                                 */
+                                log->info("Participant has rejoined the group [Hostname={}, IP={}, MAC={}]",
+                                          p.hostname, p.ip, p.mac);
+                                Message probe{};
+                                probe.type = WakeOnLanImpl::Type::SleepStatusRequest;
+                                probe.msgSeqNum = 1;
+                                bzero(probe.hostname, sizeof(probe.hostname));
+                                bzero(probe.ip, sizeof(probe.ip));
+                                bzero(probe.mac, sizeof(probe.mac));
+                                strncpy(probe.hostname, config.getHostname().c_str(), config.getHostname().size());
+                                strncpy(probe.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
+                                strncpy(probe.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+                                inetHandler->grantLease(probe);
+                                inetHandler->send(probe, p.ip);
+                                auto current = ret.first != 0 ? ret : table.snapshot();
+                                inetHandler->sendTable(current.second, current.first, p.ip);
+                            }
+                            else if (mutation.type == Table::MutationType::Update && applied)
+                                log->info("Participant announced it is awake [Hostname={}]", p.hostname);
+                            else if (mutation.type == Table::MutationType::Remove && applied)
+                                log->info("Participant was removed from the group [Hostname={}, IP={}, MAC={}]",
+                                          p.hostname, p.ip, p.mac);
+                        }
+
+                        /**
+                         * Send a single multicast message for the whole batch
+                         */
+                        if (ret.first != 0) {
+                            inetHandler->multicast(ret.second, ret.first);
+
+                            /* The group is changing: more hosts may be joining or leaving, so broadcast fast again */
+                            discoveryInterval = WAKEONLAN_DISCOVERY_MIN_INTERVAL;
+                        }
+                        batch.clear();
+                    }
                 }
+                uint64_t wakeUp = clock->now() + WAKEONLAN_DISCOVERY_TICK;
+                if (!batch.empty() && batchDeadline > clock->now())
+                    wakeUp = std::min(wakeUp, batchDeadline);
+                inetHandler->waitForMessages(ServiceQueue::Discovery, wakeUp);
             }
         });
     }
@@ -134,11 +220,23 @@ namespace WakeOnLanImpl {
             auto serviceStatus = inetHandler->getGlobalStatus();
             auto config = inetHandler->getDeviceConfig();
             bool timerSet = false;
-            time_t timer;
+            uint64_t timer = clock->now();
+            uint64_t timeout = WAKEONLAN_DISCOVERY_TIMEOUT;
+            uint64_t suspendMark = clock->suspendedTime();
+            uint64_t nextJoin = 0;
+            int joinAttempts = 0;
+            bool followedManager = false;
 
             if (serviceStatus == Unknown)
                 inetHandler->changeStatus(WaitingForSync);
 
+            /* A restarted participant tries the manager of its previous run first */
+            if (inetHandler->getManagerIp().empty()) {
+                std::string cached = inetHandler->getCachedManagerIp();
+                if (!cached.empty() && cached != config.getIpAddress())
+                    inetHandler->setManagerIp(cached);
+            }
+
             while (active) {
                 Message *m;
                 m = inetHandler->getFromDiscoveryQueue();
@@ -166,22 +264,155 @@ namespace WakeOnLanImpl {
                         break;
                     }
                 }
+                else if (m != nullptr && m->type == Type::LeaseQuery && quorum.active) {
+                    ManagerLease lease{};
+                    memcpy(&lease, m->data, sizeof(lease));
+                    if (lease.duration > 0)
+                        quorum.holder = m->hostname;
+                    else
+                        quorum.expired.insert(m->hostname);
+                }
+                /* A resumed host tells the manager it is awake, and joins again when it lost the group */
+                if (clock->suspendedSince(suspendMark)) {
+                    log->info("Host was suspended, announcing it is awake");
+                    joinAttempts = 0;
+                    if (inetHandler->getGlobalStatus() != WaitingForSync)
+                        announceJoin(true);
+                }
+
                 if(inetHandler->getGlobalStatus() == WaitingForSync)
                 {
+                    /* Joins without waiting for the manager broadcast: the cached manager first, then the segment */
+                    if (joinAttempts < WAKEONLAN_JOIN_MAX_ATTEMPTS && clock->now() >= nextJoin) {
+                        announceJoin(joinAttempts == 0);
+                        nextJoin = clock->now() + (WAKEONLAN_JOIN_RETRY << joinAttempts);
+                        joinAttempts++;
+                    }
+
                     if(!timerSet){
                         timerSet = true;
-                        timer = std::time(0);
+                        timer = clock->now();
+                        /**
+                         * A member that lost its manager already stopped hearing the monitoring requests, while a host
+                         * that never joined may be waiting for a manager broadcasting at its maximum interval. On fast
+                         * failover a member that followed a manager on this run does not wait for another manager
+                         * broadcast: the highest ranked member announces itself as soon as the manager failure is
+                         * declared. The manager cached by a previous run is given the whole timeout to answer
+                         */
+                        if (inetHandler->getManagerIp().empty())
+                            timeout = config.getMaxDiscoveryInterval() + WAKEONLAN_DISCOVERY_TIMEOUT_GRACE;
+                        else if (config.getElectionMode() == ElectionMode::FastFailover && followedManager)
+                            timeout = WAKEONLAN_DISCOVERY_FAILOVER_TIMEOUT;
+                        else
+                            timeout = WAKEONLAN_DISCOVERY_TIMEOUT;
                     }
-                    else if(std::time(0) - timer > WAKEONLAN_DISCOVERY_TIMEOUT)
+                    else if(clock->now() - timer > timeout && !inetHandler->isLeaseValid())
                     {
-                        log->info("Discovery service has timed-out. Declaring manager failure.");
-                        inetHandler->changeStatus(ManagerFailure);
+                        // the manager keeps the leadership until the lease it granted expires
+                        if (!config.getLeaseQuorum()) {
+                            log->info("Discovery service has timed-out. Declaring manager failure.");
+                            inetHandler->changeStatus(ManagerFailure);
+                        }
+                        else if (!quorum.active) {
+                            startLeaseQuorum();
+                        }
+                        else {
+                            int decision = decideLeaseQuorum();
+                            if (decision > 0) {
+                                log->info("Discovery service has timed-out and a quorum confirmed the manager lease expired. "
+                                          "Declaring manager failure.");
+                                inetHandler->changeStatus(ManagerFailure);
+                            }
+                            else if (decision < 0) {
+                                timer = clock->now(); // keeps waiting for the manager
+                            }
+                        }
                     }
                 }
+                else
+                {
+                    // the next wait for a discovery request starts from scratch
+                    timerSet = false;
+                    followedManager |= inetHandler->getGlobalStatus() == Synchronized;
+                    quorum.active = false;
+                    joinAttempts = 0;
+                }
+                inetHandler->waitForMessages(ServiceQueue::Discovery, clock->now() + WAKEONLAN_DISCOVERY_TICK);
             }
         });
     }
 
+    void DiscoveryService::announceJoin(bool cached) {
+        auto config = inetHandler->getDeviceConfig();
+        Message join{};
+        join.type = WakeOnLanImpl::Type::SleepServiceDiscovery;
+        join.msgSeqNum = WAKEONLAN_JOIN;
+        bzero(join.hostname, sizeof(join.hostname));
+        bzero(join.ip, sizeof(join.ip));
+        bzero(join.mac, sizeof(join.mac));
+        strncpy(join.hostname, config.getHostname().c_str(), config.getHostname().size());
+        strncpy(join.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
+        strncpy(join.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+
+        std::string managerIp = inetHandler->getManagerIp();
+        if (cached && !managerIp.empty()) {
+            inetHandler->send(join, managerIp);
+            log->info("Announced the host to the last known manager {}", managerIp);
+        }
+        else {
+            inetHandler->send(join, WAKEONLAN_BROADCAST_ADDRESS);
+            log->info("Announced the host to the segment");
+        }
+    }
+
+    void DiscoveryService::startLeaseQuorum() {
+        auto config = inetHandler->getDeviceConfig();
+        Message query{};
+        query.type = WakeOnLanImpl::Type::LeaseQuery;
+        query.msgSeqNum = WAKEONLAN_LEASE_QUERY;
+        bzero(query.hostname, sizeof(query.hostname));
+        bzero(query.ip, sizeof(query.ip));
+        bzero(query.mac, sizeof(query.mac));
+        strncpy(query.hostname, config.getHostname().c_str(), config.getHostname().size());
+        strncpy(query.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
+        strncpy(query.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+
+        quorum.active = true;
+        quorum.deadline = clock->now() + WAKEONLAN_LEASE_QUORUM_TIMEOUT;
+        quorum.noMembers = 1;
+        quorum.expired.clear();
+        quorum.expired.insert(config.getHostname());
+        quorum.holder.clear();
+        for (auto &member : table.get_participants_monitoring()) {
+            if (member.ip == config.getIpAddress()
+                || member.status == Table::ParticipantStatus::Manager
+                || member.status == Table::ParticipantStatus::Sleeping)
+                continue;
+            inetHandler->send(query, member.ip);
+            quorum.noMembers++;
+        }
+        log->info("Manager lease expired. Asking {} members to confirm it", quorum.noMembers - 1);
+    }
+
+    int DiscoveryService::decideLeaseQuorum() {
+        if (!quorum.holder.empty()) {
+            log->info("Member {} still holds a manager lease. Waiting for the manager", quorum.holder);
+            quorum.active = false;
+            return -1;
+        }
+        if (quorum.expired.size() > quorum.noMembers / 2) {
+            quorum.active = false;
+            return 1;
+        }
+        if (clock->now() > quorum.deadline) {
+            log->info("No quorum confirmed the manager lease expired [{}/{}]. Waiting for the manager",
+                      quorum.expired.size(), quorum.noMembers);
+            quorum.active = false;
+            return -1;
+        }
+        return 0;
+    }
+
     void DiscoveryService::run() {
         auto config = inetHandler->getDeviceConfig();
         this->log = spdlog::get("wakeonlan-api");
@@ -199,6 +430,9 @@ namespace WakeOnLanImpl {
     }
 
     void DiscoveryService::stop() {
+        active = false;
+        if (t && t->joinable())
+            t->join();
         log->info("Stop Discovery service");
     }
 
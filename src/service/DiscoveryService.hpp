@@ -1,8 +1,10 @@
 #pragma once
 #include <memory>
+#include <unordered_set>
 #include <ctime>
 #include <spdlog/spdlog.h>
 #include <../src/common/Table.hpp>
+#include <../src/common/Clock.hpp>
 #include <../src/handler/NetworkHandler.hpp>
 #include <Types.hpp>
 
@@ -54,11 +56,46 @@ namespace WakeOnLanImpl {
          */
         void runAsParticipant();
 
+        /**
+         * Sends a join announcement (a SleepServiceDiscovery with the JOIN sequence number), so the manager answers
+         * with a SYN right away and marks the host as awake.
+         * @param cached Indicates the announcement goes to the last known manager, when there is one, instead of
+         * being broadcast.
+         */
+        void announceJoin(bool cached);
+
+        /**
+         * @struct LeaseQuorum
+         * The state of a quorum check on the manager lease expiry (participant only).
+         */
+        struct LeaseQuorum {
+            bool active;                                ///< Indicates a check is in progress.
+            uint64_t deadline;                          ///< The time (ms) the check gives up waiting for replies.
+            size_t noMembers;                           ///< The live members asked, including the local host.
+            std::unordered_set<std::string> expired;    ///< The members whose lease expired.
+            std::string holder;                         ///< A member still holding a lease (empty when none).
+        };
+
+        /**
+         * Sends a LeaseQuery to every live member of the group, starting a quorum check.
+         */
+        void startLeaseQuorum();
+
+        /**
+         * Decides a quorum check with the replies received so far.
+         * @return 1 when a majority of the group confirmed the lease expiry, -1 when a member still holds a lease
+         * or the replies did not arrive in time, and 0 while the check is undecided.
+         */
+        int decideLeaseQuorum();
+
         std::unique_ptr<std::thread> t;                 ///< The service dedicated thread.
         bool active;                                    ///< Indicates service is active or not.
-        std::time_t lastTimestamp;                      ///< The last timestamp since a SleepServiceDiscovery request was sent by the Manager.
+        uint64_t lastTimestamp;                         ///< The last time (ms) a SleepServiceDiscovery request was sent by the Manager.
+        uint64_t discoveryInterval;                     ///< The time (ms) until the next SleepServiceDiscovery request (Manager only).
         std::shared_ptr<spdlog::logger> log;            ///< The DiscoveryService logger.
         Table &table;                                   ///< The singleton table.
         std::shared_ptr<NetworkHandler> inetHandler;    ///< A shared pointer to the unique Network handler.
+        std::shared_ptr<Clock> clock;                   ///< The clock shared through the Network handler.
+        LeaseQuorum quorum;                             ///< The quorum check in progress (participant only).
     };
 } // namespace WakeOnLanImpl
\ No newline at end of file
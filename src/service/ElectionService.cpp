@@ -1,18 +1,29 @@
 #include <../src/service/ElectionService.hpp>
 #include <ctime>
+#include <algorithm>
+#include <arpa/inet.h>
 
 namespace WakeOnLanImpl {
-    #define WAKEONLAN_ELECTION_TIMEOUT 25 
-    #define WAKEONLAN_ELECTION_ANSWER_TIMEOUT 5
+#define WAKEONLAN_ELECTION_TICK 100
 
     ElectionService::ElectionService(Table &t, std::shared_ptr<NetworkHandler> nh)
-        : table(t),
-        inetHandler(nh),
-        active(false),
+        : active(false),
         ongoingElection(false),
         ongoingElectionAnswered(false),
-        unreadElection(false),
-        lastWin(0)
+        table(t),
+        inetHandler(nh),
+        clock(nh->getClock()),
+        lastWin(0),
+        lastEvent(ElectionEvent::None),
+        noElections(0),
+        noTimeouts(0),
+        electionDeadline(0),
+        electionMode(nh->getDeviceConfig().getElectionMode()),
+        answerTimeout(nh->getDeviceConfig().getElectionAnswerTimeout()),
+        electionTimeout(nh->getDeviceConfig().getElectionTimeout()),
+        standby(nh->getDeviceConfig().getStandby()),
+        rankingVersion(0),
+        unreadElection(false)
     {}
 
     ElectionService::~ElectionService() {
@@ -34,13 +45,15 @@ namespace WakeOnLanImpl {
             Message *m;
             while (active)
             {
+                // keeps the ranking precomputed, so a failover does not have to read the table
+                refreshRanking();
+
                 // check message queue 
                 m = inetHandler->getFromElectionQueue();
                 if (m != nullptr)
                     switch (m->type)
                     {
                     case Type::ElectionServiceCoordinator:
-                        ongoingElection = false;
                         inetHandler->setManagerIp(m->ip);
                         {
                             std::lock_guard<std::mutex> lk(newElectionMutex);
@@ -48,6 +61,7 @@ namespace WakeOnLanImpl {
                             unreadElection = true;
                         }
                         log->info("Machine with IP {} is the new manager, election over.", m->ip);
+                        signal(ElectionEvent::CoordinatorReceived);
                     break;
                     case Type::ElectionServiceElection:
                     {
@@ -62,38 +76,40 @@ namespace WakeOnLanImpl {
                         strncpy(answer.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
                         strncpy(answer.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
                         inetHandler->send(answer, m->ip);
-                        if(!ongoingElection)
+                        // the election is run by the handler thread, so this thread keeps receiving the answers
+                        if(isElectionOver())
                         {
-                            startElection();
+                            inetHandler->changeStatus(ServiceGlobalStatus::ManagerFailure);
                         }
                     }
                     break;
                     case Type::ElectionServiceAnswer:
                         log->info("Got election answer from IP {}", m->ip);
-                        ongoingElectionAnswered = true;
+                        signal(ElectionEvent::AnswerReceived);
                     break;
                     default:
                         break;
                     }
-                if (ongoingElection && std::time(0) > ongoingElectionStart + WAKEONLAN_ELECTION_TIMEOUT)
-                {
-                    log->info("Election timed-out");
-                    ongoingElection = false;
-                }
+                else
+                    inetHandler->waitForMessages(ServiceQueue::Election, clock->now() + WAKEONLAN_ELECTION_TICK);
             }
         });
     }
 
     void ElectionService::stop() {
         active = false;
+        if (t && t->joinable())
+            t->join();
     }
 
     HandlerType ElectionService::getNewElectionResult() {
-        if(unreadElection)
         {
             std::lock_guard<std::mutex> lk(newElectionMutex);
-            unreadElection = false;
-            return newElectionResult;
+            if(unreadElection)
+            {
+                unreadElection = false;
+                return newElectionResult;
+            }
         }
         auto config = inetHandler->getDeviceConfig();
         return config.getHandlerType();
@@ -101,9 +117,34 @@ namespace WakeOnLanImpl {
 
     HandlerType ElectionService::startElection() {
         log->info("Starting new election.");
-        ongoingElection = true;
-        ongoingElectionAnswered = false;
-        ongoingElectionStart = std::time(0);
+        {
+            std::lock_guard<std::mutex> lk(electionMutex);
+            ongoingElection = true;
+            ongoingElectionAnswered = false;
+            ongoingElectionStart = clock->now();
+            electionDeadline = ongoingElectionStart + electionTimeout;
+            lastEvent = ElectionEvent::None;
+        }
+
+        if (electionMode == ElectionMode::FastFailover) {
+            std::string winner = getFastFailoverWinner();
+            if (winner == inetHandler->getDeviceConfig().getIpAddress()) {
+                log->info("Fast failover: highest ranked live member, announcing victory.");
+                announceVictory();
+                return HandlerType::Manager;
+            }
+
+            log->info("Fast failover: waiting for the coordinator message of {}.", winner);
+            {
+                std::unique_lock<std::mutex> lk(electionMutex);
+                if (!inetHandler->getManagerIp().empty()
+                    || clock->waitUntil(electionCv, lk, electionDeadline, [this]() { return !ongoingElection; }))
+                    return HandlerType::Participant;
+                electionDeadline = clock->now() + electionTimeout;
+            }
+            log->info("Fast failover: no coordinator message from {}, starting a bully election.", winner);
+        }
+
         std::vector<Table::Participant> contenders = getContenders();
         if (sendElectionMsgs(contenders) == HandlerType::Manager) // got no answer, assuming you won 
         {
@@ -114,8 +155,58 @@ namespace WakeOnLanImpl {
     }
 
     bool ElectionService::isElectionOver() {
+        std::lock_guard<std::mutex> lk(electionMutex);
         return !ongoingElection;
     }
+
+    ElectionEvent ElectionService::waitElectionOver() {
+        std::unique_lock<std::mutex> lk(electionMutex);
+        if (!clock->waitUntil(electionCv, lk, electionDeadline,
+                              [this]() { return !ongoingElection; })) {
+            lk.unlock();
+            log->info("Election timed-out");
+            signal(ElectionEvent::Timeout);
+            lk.lock();
+        }
+        return lastEvent;
+    }
+
+    void ElectionService::signal(ElectionEvent event) {
+        std::lock_guard<std::mutex> lk(electionMutex);
+        switch (event) {
+            case ElectionEvent::AnswerReceived:
+                ongoingElectionAnswered = true;
+                break;
+            case ElectionEvent::CoordinatorReceived:
+            case ElectionEvent::Victory:
+                if (ongoingElection) {
+                    latency.record(clock->now() - ongoingElectionStart);
+                    noElections++;
+                }
+                ongoingElection = false;
+                break;
+            case ElectionEvent::Timeout:
+                if (ongoingElection)
+                    noTimeouts++;
+                ongoingElection = false;
+                break;
+            default:
+                break;
+        }
+        lastEvent = event;
+        electionCv.notify_all();
+    }
+
+    ElectionStats ElectionService::getStats() {
+        ElectionStats stats;
+        {
+            std::lock_guard<std::mutex> lk(electionMutex);
+            stats.noElections = noElections;
+            stats.noTimeouts = noTimeouts;
+        }
+        stats.latency = latency.get();
+        return stats;
+    }
     
     HandlerType ElectionService::sendElectionMsgs(std::vector<Table::Participant> contenders)
     {
@@ -132,18 +223,19 @@ namespace WakeOnLanImpl {
         strncpy(electionMsg.hostname, config.getHostname().c_str(), config.getHostname().size());
         strncpy(electionMsg.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
         strncpy(electionMsg.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+        std::vector<Envelope> batch;
         for (auto contender: contenders)
-            inetHandler->send(electionMsg, contender.ip);
+            batch.push_back(Envelope{contender.ip, &electionMsg});
+        inetHandler->send(batch);
 
-        // wait N seconds 
-        time_t timer = std::time(0);
-        while(std::time(0) - timer <= WAKEONLAN_ELECTION_ANSWER_TIMEOUT) {
-            if(ongoingElectionAnswered)
+        // wait N seconds for an answer (or a coordinator) without spinning
+        {
+            std::unique_lock<std::mutex> lk(electionMutex);
+            if (clock->waitUntil(electionCv, lk, clock->now() + answerTimeout,
+                                 [this]() { return ongoingElectionAnswered || !ongoingElection; }))
                 return HandlerType::Participant;
         }
         // if no answer was received, you won!
-        if(ongoingElectionAnswered)
-            return HandlerType::Participant;
         
         log->info("No answer to election messages");
         return HandlerType::Manager;
@@ -162,18 +254,19 @@ namespace WakeOnLanImpl {
         strncpy(coordinatorMsg.hostname, config.getHostname().c_str(), config.getHostname().size());
         strncpy(coordinatorMsg.ip, config.getIpAddress().c_str(), config.getIpAddress().size());
         strncpy(coordinatorMsg.mac, config.getMacAddress().c_str(), config.getMacAddress().size());
+        std::vector<Envelope> batch;
         for (auto participant : participants)
         {
             if(participant.ip != config.getIpAddress())
-                inetHandler->send(coordinatorMsg, participant.ip);
+                batch.push_back(Envelope{participant.ip, &coordinatorMsg});
         }
-        ongoingElection = false;
+        inetHandler->send(batch);
     }
 
     void ElectionService::announceVictory()
     {
         log->info("Election won. Sending coordinator messages to all on group.");
-        ongoingElection = false;
+        signal(ElectionEvent::Victory);
         inetHandler->changeStatus(ServiceGlobalStatus::Synchronized);
         
         std::vector<Table::Participant> participants = table.get_participants_monitoring();
@@ -206,9 +299,9 @@ namespace WakeOnLanImpl {
             // make sure that you are in the table as manager
             if(p.mac == config.getMacAddress())  // using Mac address as unique identifier
             {
-                auto ret = table.update(Table::ParticipantStatus::Manager, config.getHostname());
-                if(ret.first)
+                if(table.update(Table::ParticipantStatus::Manager, config.getHostname()))
                 {
+                    auto ret = table.snapshot();
                     inetHandler->multicast(ret.second, ret.first);
                 }
             }
@@ -218,9 +311,9 @@ namespace WakeOnLanImpl {
                 {
                     // changing status to unknown because you can't know if you had to managers or
                     // if you are stepping up to substitute a fallen manager -- MonitoringService will decide
-                    auto ret = table.update(Table::ParticipantStatus::Unknown, p.hostname);
-                    if(ret.first)
+                    if(table.update(Table::ParticipantStatus::Unknown, p.hostname))
                     {
+                        auto ret = table.snapshot();
                         inetHandler->multicast(ret.second, ret.first);
                     }
                 }
@@ -257,16 +350,68 @@ namespace WakeOnLanImpl {
             // }
             // else if(lastWin == t)
             // {
-                result = self.getIpAddress().compare(p.ip);
-                // if (result == 0), we have a draw, as MAC address is unique, assuming it's self
-                // if (result <  0), compared mac address is shorter and will not be included
+                // addresses are compared as numbers, so 10.0.0.10 ranks above 10.0.0.9
+                result = rankOf(p.ip) > rankOf(self.getIpAddress());
                 log->info("Comparing your IP {} to opponents IP {}. Result was {}.", self.getIpAddress(), p.ip, result);
-                if (result < 0)
+                if (result)
                     possibleWinners.push_back(p);   
             // }             
         }
         return possibleWinners;
     }
 
+    uint64_t ElectionService::rankOf(const std::string &ip) const
+    {
+        if (!standby.empty() && ip == standby)
+            return 1ULL << 32;
+
+        struct in_addr addr{};
+        if (inet_pton(AF_INET, ip.c_str(), &addr) != 1)
+            return 0;
+        return ntohl(addr.s_addr);
+    }
+
+    void ElectionService::refreshRanking()
+    {
+        std::lock_guard<std::mutex> lk(electionMutex);
+        auto changeSet = table.waitForChanges(rankingVersion, std::chrono::milliseconds(0));
+        if (changeSet.version == rankingVersion)
+            return;
+
+        rankingVersion = changeSet.version;
+        if (changeSet.reset)
+            members.clear();
+        for (auto &change : changeSet.changes) {
+            if (change.type == Table::ChangeType::Removed)
+                members.erase(change.participant.hostname);
+            else
+                members[change.participant.hostname] = change.participant;
+        }
+
+        ranking.clear();
+        for (auto &entry : members)
+            ranking.push_back(entry.second);
+        std::sort(ranking.begin(), ranking.end(), [this](const Table::Participant &a, const Table::Participant &b) {
+            return rankOf(a.ip) > rankOf(b.ip);
+        });
+    }
+
+    std::string ElectionService::getFastFailoverWinner()
+    {
+        refreshRanking();
+
+        std::string self = inetHandler->getDeviceConfig().getIpAddress();
+        std::lock_guard<std::mutex> lk(electionMutex);
+        for (auto &member : ranking) {
+            if (member.ip == self || rankOf(member.ip) < rankOf(self))
+                break;
+            if (member.status == Table::ParticipantStatus::Sleeping || member.status == Table::ParticipantStatus::Manager
+                || member.status == Table::ParticipantStatus::Unknown)
+                continue;
+            return member.ip;
+        }
+        return self;
+    }
+
 
 } // namespace WakeOnLanImpl
\ No newline at end of file
@@ -1,12 +1,29 @@
 #pragma once
 #include <memory>
 #include <ctime>
+#include <mutex>
+#include <unordered_map>
+#include <condition_variable>
 #include <spdlog/spdlog.h>
 #include <../src/common/Table.hpp>
+#include <../src/common/Clock.hpp>
+#include <../src/common/Histogram.hpp>
 #include <../src/handler/NetworkHandler.hpp>
 #include <Types.hpp>
 
 namespace WakeOnLanImpl {
+    /**
+     * @enum ElectionEvent
+     * The events of an election.
+     */
+    enum class ElectionEvent {
+        None,                   ///< No event happened on the current election yet.
+        AnswerReceived,         ///< A higher ranked contender answered the election message.
+        CoordinatorReceived,    ///< Another host announced itself as the coordinator.
+        Victory,                ///< The local host won and announced itself as the coordinator.
+        Timeout                 ///< The election ended without a coordinator.
+    };
+
     /**
      * @class ElectionService
      * Implements the election service.
@@ -31,13 +48,28 @@ namespace WakeOnLanImpl {
         void stop();
 
         /**
-         * Starts a new election and returns the result.         
+         * Starts a new election and returns the result. On fast failover mode, the highest ranked live member
+         * announces itself immediately and the others wait for its coordinator message, falling back to a bully
+         * round when it does not arrive within the election timeout.
          * @return HandlerType, new role as decided in the election.
          */
         HandlerType startElection();
 
         bool isElectionOver();
 
+        /**
+         * Blocks until the current election ends, without consuming CPU. The election ends when a coordinator
+         * message is received, when the local host wins, or when the election times-out.
+         * @return The event that ended the election.
+         */
+        ElectionEvent waitElectionOver();
+
+        /**
+         * Gets the elections observed by the local host and their start-to-coordinator latency.
+         * @return The election statistics.
+         */
+        ElectionStats getStats();
+
         /**
          * Get results from elections started by another participant.         * 
          * @return HandlerType, new role as decided in the election or current role if no new elections.
@@ -46,18 +78,60 @@ namespace WakeOnLanImpl {
     private:
         std::unique_ptr<std::thread> t;                 ///< The service dedicated thread.
         bool active;                                    ///< Indicates service is active or not.
-        bool ongoingElection;                           ///< Indicates there is an election happening
-        bool ongoingElectionAnswered;                   ///< Indicates there was an answer to the election message in current election
-        time_t ongoingElectionStart;
+        bool ongoingElection;                           ///< Indicates there is an election happening (guarded by electionMutex)
+        bool ongoingElectionAnswered;                   ///< Indicates there was an answer to the election message in current election (guarded by electionMutex)
+        uint64_t ongoingElectionStart;                  ///< The time (ms) the ongoing election started.
         std::shared_ptr<spdlog::logger> log;            ///< The ElectionService logger.
         Table &table;                                   ///< The singleton table.
         std::shared_ptr<NetworkHandler> inetHandler;    ///< A shared pointer to the unique Network handler.
+        std::shared_ptr<Clock> clock;                   ///< The clock shared through the Network handler.
         time_t lastWin;
 
+        std::mutex electionMutex;                       ///< The mutex guarding the election state.
+        std::condition_variable electionCv;             ///< Notified on every election event.
+        ElectionEvent lastEvent;                        ///< The last event of the current election.
+        Histogram latency;                              ///< The start-to-coordinator latency of the elections.
+        uint64_t noElections;                           ///< The elections ended with a coordinator.
+        uint64_t noTimeouts;                            ///< The elections ended by a timeout.
+        uint64_t electionDeadline;                      ///< The time (ms) the current election times-out.
+        ElectionMode electionMode;                      ///< The configured election mode.
+        uint32_t answerTimeout;                         ///< The time (ms) a contender waits for answers.
+        uint32_t electionTimeout;                       ///< The time (ms) a host waits for the coordinator message.
+        std::string standby;                            ///< The designated standby IP address (empty when disabled).
+        uint64_t rankingVersion;                        ///< The table version the ranking was computed on.
+        std::unordered_map<std::string, Table::Participant> members; ///< The group members, following the table.
+        std::vector<Table::Participant> ranking;        ///< The group members from the highest to the lowest rank.
+
         std::mutex newElectionMutex;
         bool unreadElection;
         HandlerType newElectionResult;
 
+        /**
+         * Records an election event and wakes up the threads waiting for the election.
+         * @param event The election event.
+         */
+        void signal(ElectionEvent event);
+
+        /**
+         * Gets the rank of a member: its IPv4 address as a number, so 10.0.0.10 ranks above 10.0.0.9. The designated
+         * standby ranks above every other member, since it holds the current table.
+         * @param ip The member IP address.
+         * @return The member rank (0 for an invalid address).
+         */
+        uint64_t rankOf(const std::string &ip) const;
+
+        /**
+         * Applies the table changes to the members ranking.
+         */
+        void refreshRanking();
+
+        /**
+         * Gets the highest ranked live member: the local host or the first member above it that is not
+         * Sleeping nor the failed manager.
+         * @return The IP address of the fast failover winner.
+         */
+        std::string getFastFailoverWinner();
+
         void announceVictory();
         void sendCoordinatorMsgs();
         HandlerType sendElectionMsgs(std::vector<Table::Participant> contenders);
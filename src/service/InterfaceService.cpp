@@ -3,8 +3,10 @@
 #include <iomanip>
 #include <unistd.h>
 #include <signal.h>
+#include <map>
 
 namespace WakeOnLanImpl {
+#define WAKEONLAN_INTERFACE_WAIT_TIMEOUT 1000
     // InterfaceService
     InterfaceService::InterfaceService(Table &table, std::shared_ptr<NetworkHandler> netHandler) 
         : participantTable(table),
@@ -79,10 +81,30 @@ namespace WakeOnLanImpl {
         // std::cout << "\n>> ";
         std::flush(std::cout);
         int newNumParticipants;
+        uint64_t version = 0;
+        std::map<std::string, Table::Participant> view;
         while (keepRunning)
         {
             newNumParticipants = 0;
-            lastSyncParticipants = participantTable.get_participants_interface();
+            auto changeSet = participantTable.waitForChanges(version,
+                                                             std::chrono::milliseconds(WAKEONLAN_INTERFACE_WAIT_TIMEOUT));
+            if (changeSet.version == version)
+                continue;
+            version = changeSet.version;
+
+            /* Applies only the rows changed since the last redraw */
+            if (changeSet.reset)
+                view.clear();
+            for (auto &change : changeSet.changes) {
+                if (change.type == Table::ChangeType::Removed)
+                    view.erase(change.participant.hostname);
+                else
+                    view[change.participant.hostname] = change.participant;
+            }
+            lastSyncParticipants.clear();
+            lastSyncParticipants.reserve(view.size());
+            for (auto &entry : view)
+                lastSyncParticipants.push_back(entry.second);
 
             std::cout <<"\033[?25l"           // hides cursor
                       <<"\033[s"              // saves cursor position
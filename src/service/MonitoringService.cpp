@@ -1,11 +1,38 @@
 #include <../src/service/MonitoringService.hpp>
 #include <ctime>
+#include <algorithm>
+#include <random>
+#include <../src/common/TokenBucket.hpp>
 
 namespace WakeOnLanImpl {
+#define WAKEONLAN_TABLE_UPDATE_NACK_DELAY 50
+#define WAKEONLAN_TABLE_UPDATE_MAX_NACKS 5
+#define WAKEONLAN_MONITORING_TICK 10
+#define WAKEONLAN_MONITORING_INTERVAL 8000
+#define WAKEONLAN_MONITORING_TIMEOUT 7500
+#define WAKEONLAN_MONITORING_RETRY_TIMEOUT 1000
+#define WAKEONLAN_MONITORING_PROBE_TIMER 0
+#define WAKEONLAN_MONITORING_TIMEOUT_TIMER 1
+#define WAKEONLAN_MONITORING_JITTER 400
+#define WAKEONLAN_MONITORING_MIN_STD_DEVIATION 200
+#define WAKEONLAN_MANAGER_EXPECTED_INTERVAL 8000
+#define WAKEONLAN_FAILOVER_HEARTBEAT_INTERVAL 100
+#define WAKEONLAN_FAILOVER_MIN_STD_DEVIATION 25
+#define WAKEONLAN_BROADCAST_ADDRESS "255.255.255.255"
+#define WAKEONLAN_SLEEP_ANNOUNCEMENT_TIMEOUT 10000
+
     MonitoringService::MonitoringService(Table &t, std::shared_ptr<NetworkHandler> nh)
         : table(t),
         inetHandler(nh),
-        active(false)
+        clock(nh->getClock()),
+        active(false),
+        appliedSeq(0),
+        appliedEpoch(0),
+        divergence{0, 0, 0},
+        divergenceCheck(0),
+        sleepAnnounced(false),
+        sleepAnnouncedAt(0),
+        sleepAnnouncedMark(0)
     {}
 
     MonitoringService::~MonitoringService() {
@@ -39,76 +66,331 @@ namespace WakeOnLanImpl {
         log->info("Monitoring service operating as Manager.");
         active = true;
         t = std::make_unique<std::thread>([this]() {
-            time_t timestamp;
-            bool timerSet;
-            bool updated = false;
-            std::vector<std::string> sleeping_participants;
+            double threshold = inetHandler->getDeviceConfig().getSleepSuspicionThreshold();
+            uint32_t maxMisses = inetHandler->getDeviceConfig().getSleepMissedAnswers();
+            // until the first answer there is nothing learned about a participant: its retries fit in the timeout
+            uint64_t retries = static_cast<uint64_t>(maxMisses - 1) * WAKEONLAN_MONITORING_RETRY_TIMEOUT;
+            uint64_t firstTimeout = retries + WAKEONLAN_MONITORING_RETRY_TIMEOUT < WAKEONLAN_MONITORING_TIMEOUT
+                    ? WAKEONLAN_MONITORING_TIMEOUT - retries : WAKEONLAN_MONITORING_RETRY_TIMEOUT;
+            bool push = inetHandler->getDeviceConfig().getMonitoringMode() == MonitoringMode::Push;
+            bool fast = inetHandler->getDeviceConfig().getElectionMode() == ElectionMode::FastFailover;
+            uint32_t maxRate = inetHandler->getDeviceConfig().getMaxProbeRate();
+            std::mt19937 random(std::random_device{}());
+            std::uniform_int_distribution<int> jitter(-WAKEONLAN_MONITORING_JITTER, WAKEONLAN_MONITORING_JITTER);
+            uint64_t now = clock->now();
+            TokenBucket limiter(maxRate, maxRate / 10.0, now);
+            uint64_t nextTick = now;
+            uint64_t nextHeartbeat = now;
+            uint64_t version = 0;
+            uint64_t suspendMark = clock->suspendedTime();
+            TimerWheel wheel(WAKEONLAN_MONITORING_TICK, now);
+            std::unordered_map<std::string, Probe> probes;
             Message *msg;
-            auto config = inetHandler->getDeviceConfig();
             while (active)
             {
-                if(timestamp + 8 < std::time(nullptr) || !timerSet) // every 8s
+                now = clock->now();
+                if (now >= nextTick)
                 {
-                    // so it doesn't have to wait 8s for before the first call
-                    if(!timerSet)    
-                        timerSet = true;
+                    nextTick = now + WAKEONLAN_MONITORING_TICK;
+
+                    // on push mode a single broadcast heartbeat tells the whole group the manager is alive; on fast
+                    // failover it is sent on every mode, often enough for the group to detect a failure in a second
+                    if ((push || fast) && now >= nextHeartbeat) {
+                        nextHeartbeat = now + (fast ? WAKEONLAN_FAILOVER_HEARTBEAT_INTERVAL : WAKEONLAN_MONITORING_INTERVAL);
+                        Message heartbeat = getHeartbeat(table.sequence());
+                        inetHandler->grantLease(heartbeat);
+                        attachTableDigest(heartbeat);
+                        inetHandler->send(heartbeat, WAKEONLAN_BROADCAST_ADDRESS);
+                    }
+
+                    // the answers missed while the manager host was suspended do not mean the participants slept
+                    if (clock->suspendedSince(suspendMark)) {
+                        log->info("Host was suspended, restarting participants failure detection");
+                        for (auto &entry : probes) {
+                            Probe &probe = entry.second;
+                            wheel.cancel(probe.timeoutTimer);
+                            probe.timeoutTimer = 0;
+                            probe.misses = 0;
+                            if (probe.detector.started())
+                                probe.detector.restart(now);
+                            if (push && !probe.sleeping)
+                                probe.timeoutTimer = wheel.schedule(entry.first, WAKEONLAN_MONITORING_TIMEOUT_TIMER,
+                                                                    now + 2 * WAKEONLAN_MONITORING_INTERVAL);
+                        }
+                    }
 
-                    // participants still in sleeping_participants haven't answered and 
-                    // the last call are considered to be Sleeping
-                    for(auto& hostname : sleeping_participants) {
-                        auto ret = table.update(Table::ParticipantStatus::Sleeping, hostname);
-                         if ( ret.first ) {
-                             /**
-                              * Send multicast message
-                              */
-                             inetHandler->multicast(ret.second, ret.first);
-                         }
+                    // follows the group membership through the table change feed
+                    auto changeSet = table.waitForChanges(version, std::chrono::milliseconds(0));
+                    if (changeSet.version != version) {
+                        version = changeSet.version;
+                        trackMembers(changeSet, wheel, probes, now);
                     }
 
-                    // resets vectors
-                    sleeping_participants.clear();
-                    for(auto& participant: table.get_participants_monitoring())
+                    // every participant has its own probe and timeout timers; participants whose
+                    // timeout expired before an answer are considered to be Sleeping
+                    std::vector<Table::Mutation> batch;
+                    for (auto &timer : wheel.advance(now))
                     {
-                        // sleeping_participants is initialized with every participant
-                        // currently in the table
-                        if (participant.ip != config.getIpAddress()) {
-                            sleeping_participants.push_back(participant.hostname);
+                        auto it = probes.find(timer.key);
+                        if (it == probes.end())
+                            continue;
+
+                        Probe &probe = it->second;
+                        if (timer.tag == WAKEONLAN_MONITORING_PROBE_TIMER) {
+                            // over the maximum rate the probe is deferred to the next tick
+                            if (!limiter.tryAcquire(now)) {
+                                probe.probeTimer = wheel.schedule(timer.key, WAKEONLAN_MONITORING_PROBE_TIMER,
+                                                                  now + WAKEONLAN_MONITORING_TICK);
+                                continue;
+                            }
+
                             Message message = getSleepStatusRequest(1);
-                            inetHandler->send(message, participant.ip);
+                            inetHandler->grantLease(message);
+                            attachTableDigest(message);
+                            inetHandler->send(message, probe.ip);
+                            if (!probe.timeoutTimer && !probe.sleeping) {
+                                uint64_t deadline = probe.detector.started()
+                                        ? probe.detector.deadline(threshold)
+                                        : now + firstTimeout;
+                                probe.timeoutTimer = wheel.schedule(timer.key, WAKEONLAN_MONITORING_TIMEOUT_TIMER,
+                                                                    std::max(deadline, now));
+                            }
+                            // the next probe keeps the participant phase, so jitter and deferrals do not accumulate
+                            probe.nextProbe += WAKEONLAN_MONITORING_INTERVAL;
+                            if (probe.nextProbe + WAKEONLAN_MONITORING_JITTER < now)
+                                probe.nextProbe = now + WAKEONLAN_MONITORING_INTERVAL;
+                            probe.probeTimer = wheel.schedule(timer.key, WAKEONLAN_MONITORING_PROBE_TIMER,
+                                                              probe.nextProbe + jitter(random));
                         }
+                        else {
+                            // a single lost request or answer does not make the participant Sleeping: it is probed
+                            // again right away, and the retry only waits a round trip
+                            probe.timeoutTimer = 0;
+                            if (probe.misses + 1 < maxMisses) {
+                                if (!limiter.tryAcquire(now)) {
+                                    probe.timeoutTimer = wheel.schedule(timer.key, WAKEONLAN_MONITORING_TIMEOUT_TIMER,
+                                                                        now + WAKEONLAN_MONITORING_TICK);
+                                    continue;
+                                }
+                                probe.misses++;
+                                Message message = getSleepStatusRequest(1);
+                                inetHandler->grantLease(message);
+                                attachTableDigest(message);
+                                inetHandler->send(message, probe.ip);
+                                probe.timeoutTimer = wheel.schedule(timer.key, WAKEONLAN_MONITORING_TIMEOUT_TIMER,
+                                                                    now + WAKEONLAN_MONITORING_RETRY_TIMEOUT);
+                                continue;
+                            }
+                            probe.misses = 0;
+                            probe.sleeping = true;
+                            Table::Mutation mutation{Table::MutationType::Update, Table::Participant()};
+                            mutation.participant.hostname = timer.key;
+                            mutation.participant.status = Table::ParticipantStatus::Sleeping;
+                            batch.push_back(mutation);
+                        }
+                    }
+                    if (!batch.empty()) {
+                        auto ret = table.applyBatch(batch);
+                        if ( ret.first ) {
+                            /**
+                             * Send a single multicast message for every timeout of the tick
+                             */
+                            inetHandler->multicast(ret.second, ret.first);
+                        }
+                    }
+                }
 
-                        // send sleep status request 
-                        // std::cout << "Manager is sending sleep status request to "
-                        //           << participant.hostname << " @ " 
-                        //           << participant.ip << std::endl;
+                // drains the queue, so every answer received since the last iteration
+                // is applied on a single table batch
+                std::vector<Table::Mutation> batch;
+                while ((msg = inetHandler->getFromMonitoringQueue()) != nullptr)
+                {
+                    if (msg->type == Type::TableUpdateNack)
+                    {
+                        // a participant missed table updates: answer from the history or with a snapshot
+                        TableUpdateNack range{};
+                        memcpy(&range, msg->data, sizeof(range));
+                        if (!inetHandler->retransmit(msg->msgSeqNum, range.lastSeqNum, msg->ip)) {
+                            auto snapshot = table.snapshot();
+                            inetHandler->sendTable(snapshot.second, snapshot.first, msg->ip);
+                        }
+                    }
+                    else if (msg->type == Type::SleepNotice)
+                    {
+                        // a participant about to suspend is Sleeping right away, and is not probed while it sleeps
+                        auto it = probes.find(msg->hostname);
+                        if (it == probes.end() || it->second.ip != std::string(msg->ip, strnlen(msg->ip, sizeof(msg->ip))))
+                            continue;
+                        Probe &probe = it->second;
+                        wheel.cancel(probe.probeTimer);
+                        wheel.cancel(probe.timeoutTimer);
+                        probe.probeTimer = 0;
+                        probe.timeoutTimer = 0;
+                        probe.misses = 0;
+                        probe.sleeping = true;
+                        probe.suspended = true;
+
+                        Table::Mutation mutation{Table::MutationType::Update, Table::Participant()};
+                        mutation.participant.hostname = msg->hostname;
+                        mutation.participant.status = Table::ParticipantStatus::Sleeping;
+                        batch.push_back(mutation);
+                    }
+                    else if((msg->type == Type::SleepStatusRequest && msg->msgSeqNum == 2) // if there is an answer from a participant 
+                            || msg->type == Type::Heartbeat)
+                    {
+                        // the answer cancels the participant timeout
+                        auto it = probes.find(msg->hostname);
+                        if (it != probes.end()) {
+                            Probe &probe = it->second;
+                            if (probe.timeoutTimer) {
+                                wheel.cancel(probe.timeoutTimer);
+                                probe.timeoutTimer = 0;
+                            }
+                            probe.misses = 0;
+
+                            // the time a participant spent sleeping is not part of its answer distribution
+                            if (probe.sleeping)
+                                probe.detector.restart(clock->now());
+                            else
+                                probe.detector.heartbeat(clock->now());
+                            probe.sleeping = false;
+                            if (probe.suspended)
+                                resumeProbing(it->first, probe, wheel, clock->now());
+
+                            // a heartbeat carries the participant last applied update: a participant that made no
+                            // progress since its previous heartbeat missed the updates, not just an update in flight
+                            if (msg->type == Type::Heartbeat) {
+                                uint32_t seqNo = table.sequence();
+                                if (msg->msgSeqNum < seqNo && msg->msgSeqNum == probe.reportedSeq
+                                    && !inetHandler->retransmit(msg->msgSeqNum + 1, seqNo, msg->ip)) {
+                                    auto snapshot = table.snapshot();
+                                    inetHandler->sendTable(snapshot.second, snapshot.first, msg->ip);
+                                }
+                                probe.reportedSeq = msg->msgSeqNum;
+                            }
+
+                            // on push mode there is no probe: the timeout is armed by every heartbeat
+                            if (push)
+                                probe.timeoutTimer = wheel.schedule(it->first, WAKEONLAN_MONITORING_TIMEOUT_TIMER,
+                                                                    std::max(probe.detector.deadline(threshold), clock->now()));
+                        }
+                        else if (msg->type == Type::Heartbeat) {
+                            // the manager own broadcast or a host not on the group
+                            continue;
+                        }
+
+                        Table::Mutation mutation{Table::MutationType::Update, Table::Participant()};
+                        mutation.participant.hostname = msg->hostname;
+                        mutation.participant.status = Table::ParticipantStatus::Awaken;
+                        batch.push_back(mutation);
                     }
-                    timestamp = std::time(nullptr); // reset timer
                 }
-                msg = inetHandler->getFromMonitoringQueue();
-                if(msg && msg->msgSeqNum == 2) // if there is an answer from a participant 
+                if (!batch.empty())
                 {
-                    // erase participant from sleeping_participants and puts
-                    // it in awaken_participants
-                    std::string hostname = msg->hostname;
-                    auto ret = table.update(Table::ParticipantStatus::Awaken, msg->hostname);
-                    sleeping_participants.erase(std::find(sleeping_participants.begin(),
-                                                          sleeping_participants.end(),
-                                                          hostname));
+                    std::vector<Table::Change> changes;
+                    auto ret = table.applyBatch(batch, &changes);
                     if ( ret.first != 0 ) {
                         /**
                         * Send multicast message
                         */
-                        log->info("Member {} have its status changed to AWAKEN", hostname);
+                        for (auto &change : changes)
+                            log->info("Member {} have its status changed to {}", change.participant.hostname,
+                                      change.participant.status == Table::ParticipantStatus::Sleeping
+                                      ? "SLEEPING" : "AWAKEN");
                         inetHandler->multicast(ret.second, ret.first);
-                        // std::cout << "Manager got answer from "
-                        //           << msg->hostname << " @ "
-                        //           << msg->ip << std::endl;
                     }
                 }
+                inetHandler->waitForMessages(ServiceQueue::Monitoring, nextTick);
             }
         });
     }
 
+    void MonitoringService::trackMembers(const Table::ChangeSet &changeSet,
+                                         TimerWheel &wheel,
+                                         std::unordered_map<std::string, Probe> &probes,
+                                         uint64_t now)
+    {
+        auto config = inetHandler->getDeviceConfig();
+        if (changeSet.reset) {
+            for (auto &entry : probes) {
+                wheel.cancel(entry.second.probeTimer);
+                wheel.cancel(entry.second.timeoutTimer);
+            }
+            probes.clear();
+        }
+
+        std::vector<std::string> added;
+        std::unordered_set<std::string> joined;
+        for (auto &change : changeSet.changes) {
+            auto &participant = change.participant;
+            auto it = probes.find(participant.hostname);
+            if (change.type == Table::ChangeType::Removed) {
+                if (it != probes.end()) {
+                    wheel.cancel(it->second.probeTimer);
+                    wheel.cancel(it->second.timeoutTimer);
+                    probes.erase(it);
+                }
+            }
+            else if (participant.ip != config.getIpAddress()) {
+                if (it == probes.end()) {
+                    // a member starts from its status on the table, so a standby taking over with the replicated
+                    // table does not flip the Sleeping members back and forth
+                    probes.emplace(participant.hostname,
+                                   Probe{participant.ip, 0, 0, 0, 0, 0,
+                                         FailureDetector(WAKEONLAN_MONITORING_INTERVAL,
+                                                         WAKEONLAN_MONITORING_MIN_STD_DEVIATION),
+                                         participant.status == Table::ParticipantStatus::Sleeping,
+                                         false});
+                    added.push_back(participant.hostname);
+                    if (!changeSet.reset && change.type == Table::ChangeType::Inserted)
+                        joined.insert(participant.hostname);
+                }
+                else {
+                    it->second.ip = participant.ip;
+                    // a sleeping member announced it woke up: its failure detection starts over
+                    if (it->second.sleeping && participant.status == Table::ParticipantStatus::Awaken) {
+                        it->second.sleeping = false;
+                        it->second.detector.restart(now);
+                        if (it->second.suspended)
+                            resumeProbing(participant.hostname, it->second, wheel, now);
+                        if (config.getMonitoringMode() == MonitoringMode::Push && !it->second.timeoutTimer)
+                            it->second.timeoutTimer = wheel.schedule(participant.hostname,
+                                                                     WAKEONLAN_MONITORING_TIMEOUT_TIMER,
+                                                                     now + 2 * WAKEONLAN_MONITORING_INTERVAL);
+                    }
+                }
+            }
+        }
+
+        // on push mode participants are given two heartbeat intervals to send their first heartbeat
+        if (config.getMonitoringMode() == MonitoringMode::Push) {
+            for (auto &hostname : added) {
+                Probe &probe = probes.find(hostname)->second;
+                if (!probe.sleeping)
+                    probe.timeoutTimer = wheel.schedule(hostname, WAKEONLAN_MONITORING_TIMEOUT_TIMER,
+                                                        now + 2 * WAKEONLAN_MONITORING_INTERVAL);
+                // a host that just joined is synchronized by a heartbeat instead of waiting for the next broadcast one
+                if (joined.count(hostname)) {
+                    Message heartbeat = getHeartbeat(table.sequence());
+                    inetHandler->grantLease(heartbeat);
+                    attachTableDigest(heartbeat);
+                    inetHandler->send(heartbeat, probe.ip);
+                }
+            }
+            return;
+        }
+
+        // every participant is probed on its own phase of the interval, derived from its hostname, so probes
+        // and answers are spread over the interval even when many participants are added at once
+        for (auto &hostname : added) {
+            Probe &probe = probes.find(hostname)->second;
+            probe.nextProbe = now + std::hash<std::string>()(hostname) % WAKEONLAN_MONITORING_INTERVAL;
+            // a host that just joined is probed right away, so it shows up as awake without waiting for its phase
+            probe.probeTimer = wheel.schedule(hostname, WAKEONLAN_MONITORING_PROBE_TIMER,
+                                              joined.count(hostname) ? now : probe.nextProbe);
+        }
+    }
+
     void MonitoringService::runAsParticipant()
     {
         if (t)
@@ -120,8 +402,18 @@ namespace WakeOnLanImpl {
         t = std::make_unique<std::thread>([this]() {
             ServiceGlobalStatus status;
             Message *msg;
-            time_t timestamp;
+            double threshold = inetHandler->getDeviceConfig().getManagerSuspicionThreshold();
+            bool push = inetHandler->getDeviceConfig().getMonitoringMode() == MonitoringMode::Push;
+            bool fast = inetHandler->getDeviceConfig().getElectionMode() == ElectionMode::FastFailover
+                        && !inetHandler->getDeviceConfig().getLeaseQuorum();
+            FailureDetector detector(fast ? WAKEONLAN_FAILOVER_HEARTBEAT_INTERVAL : WAKEONLAN_MANAGER_EXPECTED_INTERVAL,
+                                     fast ? WAKEONLAN_FAILOVER_MIN_STD_DEVIATION : WAKEONLAN_MONITORING_MIN_STD_DEVIATION);
+            uint64_t nextHeartbeat = 0;
+            uint64_t deadline = 0;
+            uint64_t suspendMark = clock->suspendedTime();
             bool timerSet = false;
+            bool leaseWait = false;
+            bool standby = inetHandler->getDeviceConfig().getStandby() == inetHandler->getDeviceConfig().getIpAddress();
             while(active)
             {
                 status = inetHandler->getGlobalStatus();
@@ -134,16 +426,34 @@ namespace WakeOnLanImpl {
                 case ServiceGlobalStatus::Synchronized:
                     if(!timerSet)
                     {
-                        timestamp = std::time(nullptr);
+                        detector.restart(clock->now());
+                        deadline = detector.deadline(threshold);
                         timerSet = true;
                     }
-                    if(timestamp + 17 < std::time(nullptr))
+                    // the manager is suspected once the requests are late for the learned distribution,
+                    // but it keeps the leadership while the lease it granted is valid
+                    if(deadline < clock->now() && inetHandler->isLeaseValid())
                     {
-                        if(std::time(nullptr) - (timestamp + 17) > 1 ) {
-                            // participante provavelmente dormiu
-                            timestamp = std::time(nullptr);
+                        if(!leaseWait)
+                            log->info("Manager is suspected, waiting for its lease to expire in {} ms",
+                                      inetHandler->getLeaseRemaining());
+                        leaseWait = true;
+                    }
+                    else if(deadline < clock->now())
+                    {
+                        if(clock->suspendedSince(suspendMark)) {
+                            // the requests were missed because the participant host was suspended
+                            detector.restart(clock->now());
+                            deadline = detector.deadline(threshold);
                             timerSet = true;
-                            log->info("Participant has probably slept");
+                            log->info("Participant host was suspended");
+                        }
+                        else if(fast)
+                        {
+                            // on fast failover the highest ranked member takes over without waiting for a discovery
+                            inetHandler->changeStatus(ServiceGlobalStatus::ManagerFailure);
+                            timerSet = false;
+                            log->info("Participant timedout waiting for the manager heartbeats. Declaring manager failure");
                         }
                         else
                         {
@@ -154,6 +464,28 @@ namespace WakeOnLanImpl {
                         }
                         break;
                     }
+                    // on push mode the participant reports itself, carrying the last applied table sequence number,
+                    // unless it announced it sleeps: a heartbeat would mark it as awake again before it suspends
+                    if(push && !sleepAnnounced && nextHeartbeat <= clock->now())
+                    {
+                        nextHeartbeat = clock->now() + WAKEONLAN_MONITORING_INTERVAL;
+                        Message heartbeat = getHeartbeat(appliedSeq);
+                        inetHandler->send(heartbeat, inetHandler->getManagerIp());
+                    }
+                    // a host that announced it sleeps but did not suspend tells the manager it is still awake
+                    if(sleepAnnounced)
+                    {
+                        uint64_t mark = sleepAnnouncedMark;
+                        bool suspended = clock->suspendedSince(mark);
+                        if(suspended || clock->now() - sleepAnnouncedAt > WAKEONLAN_SLEEP_ANNOUNCEMENT_TIMEOUT)
+                        {
+                            sleepAnnounced = false;
+                            if(!suspended) {
+                                log->info("Host did not suspend after announcing it sleeps, telling the manager it is awake");
+                                inetHandler->send(getSleepStatusRequest(2), inetHandler->getManagerIp());
+                            }
+                        }
+                    }
                     if(msg && msg->ip == inetHandler->getManagerIp())
                     {
                         switch (msg->type) {
@@ -166,83 +498,293 @@ namespace WakeOnLanImpl {
                                 }
                                 Message answer = getSleepStatusRequest(2);
                                 inetHandler->send(answer, msg->ip);
-                                timestamp = std::time(nullptr); // reset timer
+                                detector.heartbeat(clock->now()); // reset timer
+                                deadline = detector.deadline(threshold);
+                                leaseWait = false;
+                                if (status == Synchronized)
+                                    checkTableDigest(*msg);
                                 // std::cout << "Got sleep status request. " << std::endl;
                                 break;
                             }
-                            case Type::TableUpdate: // isso vai no participant
+                            case Type::Heartbeat:
                             {
+                                if(status == ServiceGlobalStatus::Syncing) {
+                                    inetHandler->changeStatus(ServiceGlobalStatus::Synchronized);
+                                    log->info("Participant has joined the group managed by IP={} MAC={}",
+                                              msg->ip, msg->mac);
+                                }
+                                detector.heartbeat(clock->now()); // reset timer
+                                deadline = detector.deadline(threshold);
+                                leaseWait = false;
+                                if (status == Synchronized)
+                                    checkTableDigest(*msg);
+                                break;
+                            }
+                            case Type::TableUpdate: // isso vai no participant
                                 if (status == Synchronized) {
-                                    TableUpdateHeader header{};
-                                    size_t offset = 0;
-                                    char tmstmp[80];
-                                    char hostname[150];
-                                    char ip[150];
-                                    char mac[17];
-
-                                    header = *(reinterpret_cast<TableUpdateHeader*>(msg->data));
-                                    offset += sizeof(TableUpdateHeader);
-                                    log->info("Received TableUpdate [ seq_no={} no_entries={} ]", msg->msgSeqNum, (int)header.noEntries);
-
-                                    std::vector<Table::Participant> table;
-                                    for (int i=0; i < header.noEntries; i++) {
-                                        bzero(tmstmp, WAKEONLAN_FIELD_TIMESTAMP_SIZE);
-                                        bzero(hostname, WAKEONLAN_FIELD_HOSTNAME_SIZE);
-                                        bzero(ip, WAKEONLAN_FIELD_IP_SIZE);
-                                        bzero(mac, WAKEONLAN_FIELD_MAC_SIZE);
-
-                                        strncpy(tmstmp, &msg->data[offset], WAKEONLAN_FIELD_TIMESTAMP_SIZE);
-                                        offset += WAKEONLAN_FIELD_TIMESTAMP_SIZE;
-                                        memcpy(hostname, &msg->data[offset], WAKEONLAN_FIELD_HOSTNAME_SIZE);
-                                        offset += WAKEONLAN_FIELD_HOSTNAME_SIZE;
-                                        strncpy(ip, &msg->data[offset], WAKEONLAN_FIELD_IP_SIZE);
-                                        offset += WAKEONLAN_FIELD_IP_SIZE;
-                                        strncpy(mac, &msg->data[offset], WAKEONLAN_FIELD_MAC_SIZE);
-                                        offset += WAKEONLAN_FIELD_MAC_SIZE;
-
-                                        char s;
-                                        strncpy(&s, &msg->data[offset], WAKEONLAN_FIELD_STATUS_SIZE);
-                                        uint8_t status = (int)s;
-                                        offset += WAKEONLAN_FIELD_STATUS_SIZE;
-
-                                        Table::Participant member;
-                                        member.electedTimestamp = tmstmp;
-                                        member.hostname = hostname;
-                                        member.ip = ip;
-                                        member.mac = mac;
-                                        switch (status) {
-                                            case 0:
-                                                member.status = Table::ParticipantStatus::Awaken;
-                                                break;
-                                            case 1:
-                                                member.status = Table::ParticipantStatus::Sleeping;
-                                                break;
-                                            case 2:
-                                                member.status = Table::ParticipantStatus::Unknown;
-                                                break;
-                                            case 3:
-                                                member.status = Table::ParticipantStatus::Manager;
-                                                break;
-                                            default:
-                                                break;
-                                        }
-                                        table.push_back(member);
+                                    processTableUpdate(*msg);
+                                    // the standby acknowledges duplicates too, so the manager recovers a lost ack
+                                    if (standby && appliedSeq >= msg->msgSeqNum) {
+                                        Message ack = getSleepStatusRequest(appliedSeq);
+                                        ack.type = Type::StandbyAck;
+                                        inetHandler->send(ack, msg->ip);
                                     }
-                                    if (this->table.transaction(msg->msgSeqNum, table))
-                                        log->info("Processed transaction {}", msg->msgSeqNum);
                                 }
-                            }
-                            break;
+                                break;
+                            default:
+                                break;
                         }
                     }
+                    if (status == Synchronized) {
+                        checkPendingTableUpdate();
+                        resyncTable();
+                    }
                     break;
                 default: // Unknown or WaitingForSync
                     break;
                 }
+                inetHandler->waitForMessages(ServiceQueue::Monitoring, clock->now() + WAKEONLAN_MONITORING_TICK);
             }
         });
     }
 
+    std::vector<Table::Participant> MonitoringService::decodeTableUpdate(const Message &msg, TableUpdateHeader &header)
+    {
+        size_t offset = 0;
+        char tmstmp[WAKEONLAN_FIELD_TIMESTAMP_SIZE + 1];
+        char hostname[WAKEONLAN_FIELD_HOSTNAME_SIZE + 1];
+        char ip[WAKEONLAN_FIELD_IP_SIZE + 1];
+        char mac[WAKEONLAN_FIELD_MAC_SIZE + 1];
+
+        memcpy(&header, msg.data, sizeof(TableUpdateHeader));
+        offset += sizeof(TableUpdateHeader);
+
+        std::vector<Table::Participant> rows;
+        for (int i=0; i < header.noEntries && i < WAKEONLAN_TABLE_UPDATE_MAX_ENTRIES; i++) {
+            bzero(tmstmp, sizeof(tmstmp));
+            bzero(hostname, sizeof(hostname));
+            bzero(ip, sizeof(ip));
+            bzero(mac, sizeof(mac));
+
+            memcpy(tmstmp, &msg.data[offset], WAKEONLAN_FIELD_TIMESTAMP_SIZE);
+            offset += WAKEONLAN_FIELD_TIMESTAMP_SIZE;
+            memcpy(hostname, &msg.data[offset], WAKEONLAN_FIELD_HOSTNAME_SIZE);
+            offset += WAKEONLAN_FIELD_HOSTNAME_SIZE;
+            memcpy(ip, &msg.data[offset], WAKEONLAN_FIELD_IP_SIZE);
+            offset += WAKEONLAN_FIELD_IP_SIZE;
+            memcpy(mac, &msg.data[offset], WAKEONLAN_FIELD_MAC_SIZE);
+            offset += WAKEONLAN_FIELD_MAC_SIZE;
+
+            uint8_t status;
+            memcpy(&status, &msg.data[offset], WAKEONLAN_FIELD_STATUS_SIZE);
+            offset += WAKEONLAN_FIELD_STATUS_SIZE;
+
+            Table::Participant member;
+            member.electedTimestamp = tmstmp;
+            member.hostname = hostname;
+            member.ip = ip;
+            member.mac = mac;
+            switch (status) {
+                case 0:
+                    member.status = Table::ParticipantStatus::Awaken;
+                    break;
+                case 1:
+                    member.status = Table::ParticipantStatus::Sleeping;
+                    break;
+                case 3:
+                    member.status = Table::ParticipantStatus::Manager;
+                    break;
+                default:
+                    member.status = Table::ParticipantStatus::Unknown;
+                    break;
+            }
+            rows.push_back(member);
+        }
+        return rows;
+    }
+
+    void MonitoringService::processTableUpdate(const Message &msg)
+    {
+        TableUpdateHeader header{};
+        std::vector<Table::Participant> rows = decodeTableUpdate(msg, header);
+        log->info("Received TableUpdate [ seq_no={} no_entries={} fragment={}/{} ]",
+                  msg.msgSeqNum, (int)header.noEntries, header.fragment + 1, header.noFragments);
+
+        /**
+         * Sequence numbers are only comparable between updates of the same leadership: a manager restarted or
+         * elected again on the same host numbers its updates under a new epoch
+         */
+        if (appliedFrom != msg.ip || appliedEpoch != header.epoch) {
+            appliedFrom = msg.ip;
+            appliedEpoch = header.epoch;
+            appliedSeq = 0;
+            pending.fragments.clear();
+        }
+        if (appliedSeq != 0 && msg.msgSeqNum <= appliedSeq)
+            return; // duplicate or reordered update
+        if (header.fragment >= header.noFragments)
+            return;
+
+        uint64_t now = clock->now();
+        if (pending.fragments.empty() || msg.msgSeqNum > pending.seqNo) {
+            /* A newer update supersedes an incomplete older one, since every update carries the whole table */
+            pending.seqNo = msg.msgSeqNum;
+            pending.fragments.assign(header.noFragments, std::vector<Table::Participant>());
+            pending.received.assign(header.noFragments, false);
+            pending.noReceived = 0;
+            pending.noNacks = 0;
+            pending.lastActivity = now;
+        }
+        else if (msg.msgSeqNum < pending.seqNo || header.noFragments != pending.fragments.size()) {
+            return;
+        }
+
+        if (!pending.received[header.fragment]) {
+            pending.received[header.fragment] = true;
+            pending.fragments[header.fragment] = rows;
+            pending.noReceived++;
+            pending.lastActivity = now;
+        }
+        if (pending.noReceived < pending.fragments.size())
+            return;
+
+        if (appliedSeq != 0 && pending.seqNo > appliedSeq + 1)
+            log->info("TableUpdates {}..{} were missed and are covered by update {}",
+                      appliedSeq + 1, pending.seqNo - 1, pending.seqNo);
+
+        std::vector<Table::Participant> members;
+        for (auto &fragment : pending.fragments)
+            members.insert(members.end(), fragment.begin(), fragment.end());
+        /* The first update of a manager is applied whatever the table sequence number (another numbering) */
+        if (this->table.transaction(pending.seqNo, members, appliedSeq == 0))
+            log->info("Processed transaction {}", pending.seqNo);
+        appliedSeq = pending.seqNo;
+        pending.fragments.clear();
+    }
+
+    void MonitoringService::checkPendingTableUpdate()
+    {
+        if (pending.fragments.empty())
+            return;
+
+        uint64_t now = clock->now();
+        if (now - pending.lastActivity < WAKEONLAN_TABLE_UPDATE_NACK_DELAY)
+            return;
+
+        if (pending.noNacks >= WAKEONLAN_TABLE_UPDATE_MAX_NACKS) {
+            log->warn("Giving up on incomplete TableUpdate {}", pending.seqNo);
+            pending.fragments.clear();
+            return;
+        }
+
+        /* Requests every update missed since the last one applied */
+        Message nack = getSleepStatusRequest(appliedSeq != 0 ? appliedSeq + 1 : pending.seqNo);
+        nack.type = Type::TableUpdateNack;
+        TableUpdateNack range{};
+        range.lastSeqNum = pending.seqNo;
+        memcpy(nack.data, &range, sizeof(range));
+        inetHandler->send(nack, inetHandler->getManagerIp());
+        log->info("Sent TableUpdateNack [missed={}..{} fragments={}/{}]",
+                  nack.msgSeqNum, pending.seqNo, pending.noReceived, pending.fragments.size());
+
+        pending.noNacks++;
+        pending.lastActivity = now;
+    }
+
+    void MonitoringService::attachTableDigest(Message &message)
+    {
+        auto digest = table.digest();
+        TableDigest payload{digest.first, inetHandler->getEpoch(), digest.second};
+        memcpy(message.data + sizeof(ManagerLease), &payload, sizeof(payload));
+    }
+
+    void MonitoringService::checkTableDigest(const Message &msg)
+    {
+        TableDigest remote{};
+        memcpy(&remote, msg.data + sizeof(ManagerLease), sizeof(remote));
+        if (remote.seqNum == 0)
+            return; // the request carries no digest
+
+        auto local = table.digest();
+        if (local.first == remote.seqNum && local.second == remote.digest) {
+            divergence = TableDigest{0, 0, 0};
+            return;
+        }
+        // the update matching the digest may still be on its way, so the table is compared again a bit later
+        if (divergence.seqNum == 0)
+            divergenceCheck = clock->now() + WAKEONLAN_TABLE_UPDATE_NACK_DELAY;
+        divergence = remote;
+    }
+
+    void MonitoringService::resyncTable()
+    {
+        if (divergence.seqNum == 0 || clock->now() < divergenceCheck || !pending.fragments.empty())
+            return; // no divergence, or the update being collected is recovered by its own NACKs
+
+        TableDigest remote = divergence;
+        divergence = TableDigest{0, 0, 0};
+        std::string managerIp = inetHandler->getManagerIp();
+        auto local = table.digest();
+        if (local.first == remote.seqNum && local.second == remote.digest)
+            return;
+
+        /**
+         * Sequence numbers are only comparable under the same manager epoch: a newer update of the manager may
+         * have arrived meanwhile, while a manager restarted on the same host numbers its updates from scratch
+         */
+        bool sameEpoch = appliedFrom == managerIp && appliedEpoch == remote.epoch && appliedSeq != 0;
+        if (sameEpoch && appliedSeq > remote.seqNum)
+            return;
+
+        /**
+         * A table behind the manager misses the updates after the last one applied; a table that diverged at the
+         * same (or a foreign) sequence number is replaced by the manager table, accepted whatever its number
+         */
+        uint32_t first = remote.seqNum;
+        if (sameEpoch && local.first < remote.seqNum && appliedSeq < remote.seqNum)
+            first = appliedSeq + 1;
+        else
+            appliedSeq = 0;
+
+        Message nack = getSleepStatusRequest(first);
+        nack.type = Type::TableUpdateNack;
+        TableUpdateNack range{};
+        range.lastSeqNum = remote.seqNum;
+        memcpy(nack.data, &range, sizeof(range));
+        inetHandler->send(nack, managerIp);
+        log->warn("Table does not match the manager digest [local_seq={} manager_seq={}], requesting updates {}..{}",
+                  local.first, remote.seqNum, first, remote.seqNum);
+    }
+
+    void MonitoringService::resumeProbing(const std::string &hostname, Probe &probe, TimerWheel &wheel, uint64_t now)
+    {
+        probe.suspended = false;
+        if (inetHandler->getDeviceConfig().getMonitoringMode() == MonitoringMode::Push || probe.probeTimer)
+            return;
+        // the participant keeps its phase on the interval
+        probe.nextProbe = now + std::hash<std::string>()(hostname) % WAKEONLAN_MONITORING_INTERVAL;
+        probe.probeTimer = wheel.schedule(hostname, WAKEONLAN_MONITORING_PROBE_TIMER, probe.nextProbe);
+    }
+
+    bool MonitoringService::announceSleep()
+    {
+        Config config = inetHandler->getDeviceConfig();
+        std::string managerIp = inetHandler->getManagerIp();
+        if (config.getHandlerType() != HandlerType::Participant || managerIp.empty()) {
+            log->info("Host is about to sleep, but follows no manager to tell");
+            return false;
+        }
+
+        sleepAnnouncedAt = clock->now();
+        sleepAnnouncedMark = clock->suspendedTime();
+        sleepAnnounced = true;
+
+        Message message = getSleepStatusRequest(0);
+        message.type = WakeOnLanImpl::Type::SleepNotice;
+        log->info("Host is about to sleep, telling the manager {}", managerIp);
+        return inetHandler->send(message, managerIp);
+    }
+
     Message MonitoringService::getSleepStatusRequest(int seq)
     {
         Config config = inetHandler->getDeviceConfig();
@@ -259,7 +801,19 @@ namespace WakeOnLanImpl {
         return message;
     }
 
+    Message MonitoringService::getHeartbeat(uint32_t seqNo)
+    {
+        Message message = getSleepStatusRequest(0);
+        message.type = WakeOnLanImpl::Type::Heartbeat;
+        message.msgSeqNum = seqNo;
+
+        return message;
+    }
+
     void MonitoringService::stop() {
+        active = false;
+        if (t && t->joinable())
+            t->join();
         log->info("Stop Monitoring service");
     }
 
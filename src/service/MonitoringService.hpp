@@ -1,7 +1,14 @@
 
 #pragma once
+#include <atomic>
 #include <memory>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
 #include <../src/common/Table.hpp>
+#include <../src/common/TimerWheel.hpp>
+#include <../src/common/FailureDetector.hpp>
+#include <../src/common/Clock.hpp>
 #include <../src/handler/NetworkHandler.hpp>
 #include <Types.hpp>
 
@@ -39,6 +46,13 @@ namespace WakeOnLanImpl {
          * Indicate to the service that there has been a change in it's role 
          */
         void notifyRoleChange();
+
+        /**
+         * Tells the manager the local host is about to suspend, so the manager marks it as Sleeping right away
+         * and stops probing it until it announces it woke up.
+         * @returns A bool indicating the announcement was sent (false when the host follows no manager).
+         */
+        bool announceSleep();
     private:
         /**
          * For every entry in table, if participant is:
@@ -46,10 +60,48 @@ namespace WakeOnLanImpl {
          * - Syncing: does nothing (doesn't happen)
          * - Unknown: does nothing (doesn't happen)
          * - Synchronized: sends sleep status request messages every 8s.
-         * 
+         *
+         * On push mode no request is sent: participants send heartbeats instead, and the manager
+         * broadcasts a single heartbeat every 8s. A participant whose heartbeats report the same
+         * table update twice while the table moved on is sent the latest update, or the whole table.
+         *
+         * Every participant has its own probe schedule, on a phase of the interval derived from its
+         * hostname and jittered on every probe, and a timeout kept on a ::TimerWheel,
+         * and an answer cancels the participant timeout. The timeout is the time the participant
+         * ::FailureDetector suspicion level reaches the configured threshold. A participant is marked as
+         * Sleeping after 3 consecutive timeouts, one interval apart, so a single lost answer is tolerated.
          */
         void runAsManager();
 
+        /**
+         * @struct Probe
+         * The monitoring state of a participant (manager only).
+         */
+        struct Probe {
+            std::string ip;                         ///< The participant IP address.
+            TimerWheel::TimerId probeTimer;         ///< The timer sending the next SleepStatusRequest.
+            TimerWheel::TimerId timeoutTimer;       ///< The timer marking the participant as Sleeping (0 when not waiting an answer).
+            uint64_t nextProbe;                     ///< The time of the next probe before jitter (keeps the participant phase).
+            uint32_t misses;                        ///< The consecutive timeouts since the last answer.
+            uint32_t reportedSeq;                   ///< The last applied update reported by the participant heartbeats.
+            FailureDetector detector;               ///< The failure detector learning the participant answers.
+            bool sleeping;                          ///< Indicates the participant was marked as Sleeping.
+            bool suspended;                         ///< Indicates the participant announced it sleeps (it is not probed).
+        };
+
+        /**
+         * Updates the monitored participants from the table changes, scheduling the
+         * probes of new participants and canceling the timers of removed ones.
+         * @param changeSet The table changes.
+         * @param wheel The timer wheel.
+         * @param probes The monitored participants.
+         * @param now The current time, in milliseconds (::Clock).
+         */
+        void trackMembers(const Table::ChangeSet &changeSet,
+                          TimerWheel &wheel,
+                          std::unordered_map<std::string, Probe> &probes,
+                          uint64_t now);
+
         /**
          * If participant is:
          * - WaitingForSync: does nothing
@@ -58,10 +110,23 @@ namespace WakeOnLanImpl {
          *   If no message is received, changes status to WaitingForSync          
          * - Synchronized: listens for sleep status request, answering with current status
          * - Unknown: does nothing
+         *
+         * On push mode the participant sends a heartbeat to the manager every 8s instead,
+         * and the manager heartbeats take the place of the requests.
          * 
          */
         void runAsParticipant();
 
+        /**
+         * Starts probing again a participant that announced it slept, once it is known to be awake.
+         * @param hostname The participant hostname.
+         * @param probe The participant monitoring state.
+         * @param wheel The timer wheel of the probes.
+         * @param now The current time.
+         * @returns None.
+         */
+        void resumeProbing(const std::string &hostname, Probe &probe, TimerWheel &wheel, uint64_t now);
+
         /**
          * Gets the received SleepStatusRequest message.
          * @param seq
@@ -69,11 +134,81 @@ namespace WakeOnLanImpl {
          */
         Message getSleepStatusRequest(int seq);
 
+        /**
+         * Gets a Heartbeat message (push monitoring mode).
+         * @param seqNo The table sequence number known by the sender.
+         * @return A message.
+         */
+        Message getHeartbeat(uint32_t seqNo);
+
+        /**
+         * Decodes the table rows carried by a TableUpdate fragment.
+         * @param msg The TableUpdate message.
+         * @param header The header receiving the fragment information.
+         * @return The table rows of the fragment.
+         */
+        std::vector<Table::Participant> decodeTableUpdate(const Message &msg, TableUpdateHeader &header);
+
+        /**
+         * Collects a TableUpdate fragment received by the participant. Once every fragment of the
+         * update is received, the table is replaced by the update. Duplicated and reordered updates are discarded.
+         * @param msg The TableUpdate message.
+         */
+        void processTableUpdate(const Message &msg);
+
+        /**
+         * Requests the retransmission of the update being collected when its missing fragments
+         * do not arrive in time, sending a TableUpdateNack for the missed range to the manager.
+         */
+        void checkPendingTableUpdate();
+
+        /**
+         * Adds the digest of the table to a manager request, so the participants check their table against it.
+         * @param message The SleepStatusRequest or Heartbeat request.
+         */
+        void attachTableDigest(Message &message);
+
+        /**
+         * Compares the table with the digest carried by a manager request. A mismatch is resolved by
+         * ::resyncTable() once the updates in flight had the time to arrive.
+         * @param msg The SleepStatusRequest or Heartbeat request of the manager.
+         */
+        void checkTableDigest(const Message &msg);
+
+        /**
+         * Requests the updates missed since the last one applied when the table still does not match the digest
+         * of the manager, or the table at the manager sequence number when the tables diverged.
+         */
+        void resyncTable();
+
+        /**
+         * @struct PendingUpdate
+         * A table update whose fragments are being collected by the participant.
+         */
+        struct PendingUpdate {
+            uint32_t seqNo;                                             ///< The update sequence number.
+            std::vector<std::vector<Table::Participant>> fragments;     ///< The rows of each fragment (empty when no update is pending).
+            std::vector<bool> received;                                 ///< Indicates which fragments were received.
+            size_t noReceived;                                          ///< The number of received fragments.
+            int noNacks;                                                ///< The number of NACKs sent for the update.
+            uint64_t lastActivity;                                      ///< The last time (ms) a fragment arrived or a NACK was sent.
+        };
+
         Table &table;                                   ///< The singleton table.
         std::shared_ptr<NetworkHandler> inetHandler;    ///< A shared pointer to the unique Network handler.
+        std::shared_ptr<Clock> clock;                   ///< The clock shared through the Network handler.
         std::unique_ptr<std::thread> t;                 ///< The service dedicated thread.
         bool active;                                    ///< Indicates service is active or not.
         std::shared_ptr<spdlog::logger> log;            ///< The DiscoveryService logger.
+        PendingUpdate pending;                          ///< The table update being collected (participant only).
+        uint32_t appliedSeq;                            ///< The sequence number of the last applied table update.
+        std::string appliedFrom;                        ///< The IP address of the manager that sent the last applied update.
+        uint32_t appliedEpoch;                          ///< The manager epoch of the last applied update.
+        TableDigest divergence;                         ///< The manager digest the table did not match (seqNum 0 when none).
+        uint64_t divergenceCheck;                       ///< The time the table is compared again with the divergent digest.
+        std::atomic<bool> sleepAnnounced;               ///< Indicates the host announced it sleeps (participant only).
+        std::atomic<uint64_t> sleepAnnouncedAt;         ///< The time the host announced it sleeps.
+        std::atomic<uint64_t> sleepAnnouncedMark;       ///< The suspended time of the clock when the host announced it sleeps.
     };
     
 } // namespace WakeOnLanImpl
\ No newline at end of file